@@ -0,0 +1,216 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/cpu_dispatch.h"
+#include "../src/gain_ramp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_BLOCK_SIZE 8192U
+#define MIN_BLOCK_SIZE 16U
+#define SAMPLE_RATE 48000.F
+#define RELEASE_TIME_MS 30.F
+#define DEFAULT_SAMPLES 50000000U
+
+#ifndef M_PI
+#define M_PI 3.1415926535F
+#endif
+
+typedef enum Kernel {
+  KERNEL_BLOCK = 0, // Constant gain per block, as the crossfade used to mix
+  KERNEL_RAMP = 1,  // Per sample ramp while the gain is still moving
+  KERNEL_SETTLED = 2,
+} Kernel;
+
+static const char *const kernel_names[] = {"block", "ramp", "settled"};
+
+typedef struct BlockMix {
+  float tau;
+  float gain;
+  float target;
+} BlockMix;
+
+static void block_mix(BlockMix *self, const uint32_t number_of_samples,
+                      const float *dry, float *output) {
+  self->gain += self->tau * (self->target - self->gain);
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    output[k] = (1.F - self->gain) * dry[k] + output[k] * self->gain;
+  }
+}
+
+static double now_ns(void) {
+  struct timespec time_now;
+  clock_gettime(CLOCK_MONOTONIC, &time_now);
+  return (double)time_now.tv_sec * 1e9 + (double)time_now.tv_nsec;
+}
+
+// Runs one kernel over the same audio and returns its cost per sample.
+// The gain is toggled every block so the ramp never settles
+static double run_kernel(const Kernel kernel, const uint32_t block_size,
+                         const uint32_t number_of_samples, const float *dry,
+                         float *wet) {
+  BlockMix block = {
+      1.F - expf(-128.F * M_PI * RELEASE_TIME_MS / SAMPLE_RATE), 0.F, 1.F};
+  GainRamp *ramp =
+      gain_ramp_initialize(expf(-M_PI * RELEASE_TIME_MS / SAMPLE_RATE), 0.F);
+  if (!ramp) {
+    return -1.0;
+  }
+  gain_ramp_set_target(ramp, 0.5F);
+
+  const uint32_t number_of_blocks = number_of_samples / block_size;
+  const double start = now_ns();
+
+  for (uint32_t b = 0U; b < number_of_blocks; b++) {
+    const float target = (b & 1U) ? 0.25F : 0.75F;
+
+    switch (kernel) {
+    case KERNEL_BLOCK:
+      block.target = target;
+      block_mix(&block, block_size, dry, wet);
+      break;
+    case KERNEL_RAMP:
+      gain_ramp_set_target(ramp, target);
+      gain_ramp_mix(ramp, block_size, dry, wet, wet);
+      break;
+    case KERNEL_SETTLED:
+      gain_ramp_mix(ramp, block_size, dry, wet, wet);
+      break;
+    }
+  }
+
+  const double elapsed = now_ns() - start;
+  gain_ramp_free(ramp);
+
+  return elapsed / ((double)number_of_blocks * block_size);
+}
+
+// Largest jump of the gain between two samples while fading in from dry,
+// which is what is heard as zipper noise
+static float max_gain_step(const Kernel kernel, const uint32_t block_size) {
+  static float zeros[MAX_BLOCK_SIZE];
+  static float gains[MAX_BLOCK_SIZE];
+  BlockMix block = {
+      1.F - expf(-128.F * M_PI * RELEASE_TIME_MS / SAMPLE_RATE), 0.F, 1.F};
+  GainRamp *ramp =
+      gain_ramp_initialize(expf(-M_PI * RELEASE_TIME_MS / SAMPLE_RATE), 0.F);
+  if (!ramp) {
+    return -1.F;
+  }
+  gain_ramp_set_target(ramp, 1.F);
+
+  float previous = 0.F;
+  float max_step = 0.F;
+  for (uint32_t played = 0U; played < (uint32_t)SAMPLE_RATE;
+       played += block_size) {
+    for (uint32_t k = 0U; k < block_size; k++) {
+      gains[k] = 1.F;
+    }
+
+    if (kernel == KERNEL_BLOCK) {
+      block_mix(&block, block_size, zeros, gains);
+    } else {
+      gain_ramp_mix(ramp, block_size, zeros, gains, gains);
+    }
+
+    for (uint32_t k = 0U; k < block_size; k++) {
+      max_step = fmaxf(max_step, fabsf(gains[k] - previous));
+      previous = gains[k];
+    }
+  }
+
+  gain_ramp_free(ramp);
+
+  return max_step;
+}
+
+static void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options]\n"
+          "Options:\n"
+          "  -n SAMPLES  samples mixed per configuration (default: %u)\n"
+          "  -b SIZE     only run the given block size\n",
+          program, DEFAULT_SAMPLES);
+}
+
+int main(int argc, char **argv) {
+  uint32_t number_of_samples = DEFAULT_SAMPLES;
+  uint32_t only_block_size = 0U;
+
+  int arg = 1;
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    switch (argv[arg][1]) {
+    case 'n':
+      number_of_samples = (uint32_t)strtoul(argv[arg + 1], NULL, 10);
+      break;
+    case 'b':
+      only_block_size = (uint32_t)strtoul(argv[arg + 1], NULL, 10);
+      break;
+    default:
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (arg != argc || number_of_samples < MAX_BLOCK_SIZE) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  static float dry[MAX_BLOCK_SIZE];
+  static float wet[MAX_BLOCK_SIZE];
+  for (uint32_t k = 0U; k < MAX_BLOCK_SIZE; k++) {
+    dry[k] = sinf(0.01F * (float)k);
+    wet[k] = 0.5F * dry[k];
+  }
+
+  const char *level = cpu_dispatch_level_name(cpu_dispatch_level());
+  printf("kernel,level,block_size,ns_per_sample,max_gain_step\n");
+
+  for (uint32_t block_size = MIN_BLOCK_SIZE; block_size <= MAX_BLOCK_SIZE;
+       block_size *= 2U) {
+    if (only_block_size > 0U && only_block_size != block_size) {
+      continue;
+    }
+
+    for (size_t k = 0U; k < sizeof(kernel_names) / sizeof(kernel_names[0]);
+         k++) {
+      const Kernel kernel = (Kernel)k;
+      const double ns_per_sample =
+          run_kernel(kernel, block_size, number_of_samples, dry, wet);
+      if (ns_per_sample < 0.0) {
+        return EXIT_FAILURE;
+      }
+
+      printf("%s,%s,%u,%.3f,%.5f\n", kernel_names[k],
+             kernel == KERNEL_BLOCK ? "compiler" : level,
+             (unsigned int)block_size, ns_per_sample,
+             max_gain_step(kernel, block_size));
+      fflush(stdout);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
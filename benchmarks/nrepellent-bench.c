@@ -0,0 +1,292 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../tools/lv2_host.h"
+#include "../tools/plugin_variants.h"
+#include "../tools/test_signals.h"
+#include "lv2/atom/atom.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_BLOCK_SIZE 8192U
+#define MIN_BLOCK_SIZE 16U
+#define LEARN_SECONDS 0.5
+#define DEFAULT_SECONDS 2.0
+
+static const double sample_rates[] = {44100.0, 48000.0, 96000.0, 192000.0};
+
+typedef enum InputSignal {
+  SIGNAL_NOISE = 0,
+  SIGNAL_SPEECH = 1,
+  SIGNAL_DECAY = 2,
+} InputSignal;
+
+typedef struct BenchmarkResult {
+  double ns_per_sample;
+  double p99_block_ns;
+  double realtime_factor;
+} BenchmarkResult;
+
+static double now_ns(void) {
+  struct timespec time_now;
+  clock_gettime(CLOCK_MONOTONIC, &time_now);
+  return (double)time_now.tv_sec * 1e9 + (double)time_now.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static bool run_benchmark(Lv2Host *host, const LV2_Descriptor *descriptor,
+                          const PluginVariant *variant,
+                          const double sample_rate, const uint32_t block_size,
+                          const double seconds, const InputSignal signal,
+                          BenchmarkResult *result) {
+  static float input[PLUGIN_VARIANT_MAX_CHANNELS][MAX_BLOCK_SIZE];
+  static float speech[MAX_BLOCK_SIZE];
+  static float output[PLUGIN_VARIANT_MAX_CHANNELS][MAX_BLOCK_SIZE];
+  float controls[PLUGIN_VARIANT_MAX_PORTS];
+  LV2_Atom_Sequence control = {
+      .atom = {.size = sizeof(LV2_Atom_Sequence_Body),
+               .type = lv2_host_map(host, LV2_ATOM__Sequence)},
+  };
+  uint32_t seed = 1U;
+
+  SpeechSource *speech_source = speech_source_initialize(sample_rate);
+  if (!speech_source) {
+    return false;
+  }
+
+  LV2_Handle instance = descriptor->instantiate(
+      descriptor, sample_rate, "", lv2_host_get_features(host));
+  if (!instance) {
+    speech_source_free(speech_source);
+    return false;
+  }
+
+  memcpy(controls, variant->defaults, sizeof(controls));
+  for (uint32_t port = 0U; port < variant->number_of_ports; port++) {
+    descriptor->connect_port(instance, port, &controls[port]);
+  }
+  for (uint32_t c = 0U; c < variant->channels; c++) {
+    const uint32_t port = variant->first_audio_port + 2U * c;
+    descriptor->connect_port(instance, port, input[c]);
+    descriptor->connect_port(instance, port + 1U, output[c]);
+  }
+  if (variant->control_port != PLUGIN_VARIANT_NO_PORT) {
+    descriptor->connect_port(instance, variant->control_port, &control);
+  }
+
+  if (descriptor->activate) {
+    descriptor->activate(instance);
+  }
+
+  const uint32_t learn_blocks =
+      variant->learn_port != PLUGIN_VARIANT_NO_PORT
+          ? (uint32_t)(LEARN_SECONDS * sample_rate / block_size) + 1U
+          : 0U;
+  if (learn_blocks > 0U) {
+    controls[variant->learn_port] = 1.F;
+  }
+  for (uint32_t block = 0U; block < learn_blocks; block++) {
+    for (uint32_t c = 0U; c < variant->channels; c++) {
+      white_noise_fill(input[c], block_size, &seed);
+    }
+    descriptor->run(instance, block_size);
+  }
+  if (learn_blocks > 0U) {
+    controls[variant->learn_port] = 0.F;
+  }
+
+  const uint32_t number_of_blocks =
+      (uint32_t)(seconds * sample_rate / block_size) + 1U;
+  double *block_times = (double *)calloc(number_of_blocks, sizeof(double));
+  if (!block_times) {
+    speech_source_free(speech_source);
+    descriptor->cleanup(instance);
+    return false;
+  }
+
+  double total_ns = 0.0;
+  uint64_t position = 0U;
+  for (uint32_t block = 0U; block < number_of_blocks; block++) {
+    if (signal == SIGNAL_SPEECH) {
+      speech_source_fill(speech_source, speech, block_size);
+    }
+    for (uint32_t c = 0U; c < variant->channels; c++) {
+      white_noise_fill(input[c], block_size, &seed);
+      if (signal == SIGNAL_SPEECH) {
+        for (uint32_t k = 0U; k < block_size; k++) {
+          input[c][k] += speech[k];
+        }
+      }
+    }
+    if (signal == SIGNAL_DECAY) {
+      for (uint32_t c = 0U; c < variant->channels; c++) {
+        decay_apply(input[c], block_size, sample_rate, position);
+      }
+      position += block_size;
+    }
+
+    const double start = now_ns();
+    descriptor->run(instance, block_size);
+    block_times[block] = now_ns() - start;
+    total_ns += block_times[block];
+  }
+
+  qsort(block_times, number_of_blocks, sizeof(double), compare_doubles);
+
+  const uint32_t number_of_samples = number_of_blocks * block_size;
+  const uint32_t p99_index = (uint32_t)(0.99 * (number_of_blocks - 1U));
+  result->ns_per_sample = total_ns / (double)number_of_samples;
+  result->p99_block_ns = block_times[p99_index];
+  result->realtime_factor =
+      ((double)number_of_samples / sample_rate) / (total_ns * 1e-9);
+
+  free(block_times);
+  speech_source_free(speech_source);
+  if (descriptor->deactivate) {
+    descriptor->deactivate(instance);
+  }
+  descriptor->cleanup(instance);
+
+  return true;
+}
+
+static void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] NREPELLENT_LIBRARY NREPELLENT_ADAPTIVE_LIBRARY\n"
+          "Options:\n"
+          "  -d SECONDS  audio measured per configuration (default: %.1f)\n"
+          "  -p NAME     only run the given plugin variant\n"
+          "  -r RATE     only run the given sample rate\n"
+          "  -b SIZE     only run the given block size\n"
+          "  -s SIGNAL   measured input, noise, speech or decay (default: "
+          "noise)\n",
+          program, DEFAULT_SECONDS);
+}
+
+int main(int argc, char **argv) {
+  double seconds = DEFAULT_SECONDS;
+  const char *only_variant = NULL;
+  double only_rate = 0.0;
+  uint32_t only_block_size = 0U;
+  InputSignal signal = SIGNAL_NOISE;
+
+  int arg = 1;
+  for (; arg + 1 < argc && argv[arg][0] == '-'; arg += 2) {
+    switch (argv[arg][1]) {
+    case 'd':
+      seconds = strtod(argv[arg + 1], NULL);
+      break;
+    case 'p':
+      only_variant = argv[arg + 1];
+      break;
+    case 'r':
+      only_rate = strtod(argv[arg + 1], NULL);
+      break;
+    case 'b':
+      only_block_size = (uint32_t)strtoul(argv[arg + 1], NULL, 10);
+      break;
+    case 's':
+      if (strcmp(argv[arg + 1], "speech") == 0) {
+        signal = SIGNAL_SPEECH;
+      } else if (strcmp(argv[arg + 1], "decay") == 0) {
+        signal = SIGNAL_DECAY;
+      } else if (strcmp(argv[arg + 1], "noise") != 0) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+      }
+      break;
+    default:
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc - arg != 2 || seconds <= 0.0) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const char *libraries[2] = {argv[arg], argv[arg + 1]};
+
+  Lv2Host *host = lv2_host_initialize();
+  if (!host) {
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_SUCCESS;
+  printf("plugin,sample_rate,block_size,ns_per_sample,p99_block_ns,"
+         "realtime_factor\n");
+
+  for (size_t v = 0U; v < number_of_plugin_variants; v++) {
+    const PluginVariant *variant = &plugin_variants[v];
+    if (only_variant && strcmp(only_variant, variant->name) != 0) {
+      continue;
+    }
+
+    const LV2_Descriptor *descriptor = lv2_host_load_descriptor(
+        host, libraries[variant->library], variant->uri);
+    if (!descriptor) {
+      fprintf(stderr, "Could not load <%s> from %s\n", variant->uri,
+              libraries[variant->library]);
+      status = EXIT_FAILURE;
+      continue;
+    }
+
+    for (size_t r = 0U; r < sizeof(sample_rates) / sizeof(sample_rates[0]);
+         r++) {
+      if (only_rate > 0.0 && only_rate != sample_rates[r]) {
+        continue;
+      }
+
+      for (uint32_t block_size = MIN_BLOCK_SIZE; block_size <= MAX_BLOCK_SIZE;
+           block_size *= 2U) {
+        if (only_block_size > 0U && only_block_size != block_size) {
+          continue;
+        }
+
+        BenchmarkResult result;
+        if (!run_benchmark(host, descriptor, variant, sample_rates[r],
+                           block_size, seconds, signal, &result)) {
+          fprintf(stderr, "Could not instantiate <%s>\n", variant->uri);
+          status = EXIT_FAILURE;
+          continue;
+        }
+
+        printf("%s,%.0f,%u,%.3f,%.0f,%.2f\n", variant->name, sample_rates[r],
+               (unsigned int)block_size, result.ns_per_sample,
+               result.p99_block_ns, result.realtime_factor);
+        fflush(stdout);
+      }
+    }
+  }
+
+  lv2_host_free(host);
+
+  return status;
+}
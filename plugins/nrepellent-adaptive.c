@@ -18,22 +18,70 @@ along with this program; if not, write to the Free Software Foundation,
 Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include "../src/channel_worker.h"
+#include "../src/control_automation.h"
+#include "../src/cpu_dispatch.h"
+#include "../src/denormal_guard.h"
+#include "../src/reduction_meter.h"
 #include "../src/signal_crossfade.h"
+#include "../src/timing_trace.h"
+#include "../src/worker_job.h"
 #include "lv2/atom/atom.h"
+#include "lv2/atom/util.h"
 #include "lv2/core/lv2.h"
 #include "lv2/core/lv2_util.h"
 #include "lv2/log/logger.h"
+#include "lv2/patch/patch.h"
 #include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
 #include "specbleach_adenoiser.h"
+#include <math.h>
+#include <stdatomic.h>
 #include <stdlib.h>
+#include <string.h>
+
+#define PARAMETER_SMOOTHING_MS 50.F
+#define PARAMETER_SETTLE_THRESHOLD 1e-3F
+#define PARAMETER_STEP_SAMPLES 128U // Longest span while parameters glide
+#define MAX_SPAN 2048U // Longest span processed at once, sizes helper copies
+
+// Width of the multichannel variant, set by the build
+#ifndef NOISEREPELLENT_MULTICHANNEL_CHANNELS
+#define NOISEREPELLENT_MULTICHANNEL_CHANNELS 8U
+#endif
 
 #define NOISEREPELLENT_ADAPTIVE_URI                                            \
   "https://github.com/lucianodato/noise-repellent#adaptive"
 #define NOISEREPELLENT_ADAPTIVE_STEREO_URI                                     \
   "https://github.com/lucianodato/noise-repellent#adaptive-stereo"
+#define NOISEREPELLENT_ADAPTIVE_MULTICHANNEL_URI                               \
+  "https://github.com/lucianodato/noise-repellent#adaptive-multichannel"
+
+// Control inputs can also be set through timestamped patch:Set events on the
+// control port, each one is a parameter named after the port
+#define NOISEREPELLENT_CONTROLS 5U
+#define NOISEREPELLENT_PARAMETER_URI(name)                                     \
+  "https://github.com/lucianodato/noise-repellent#adaptive-" name
+
+static const char *const control_parameters[NOISEREPELLENT_CONTROLS] = {
+    NOISEREPELLENT_PARAMETER_URI("reduction"),
+    NOISEREPELLENT_PARAMETER_URI("offset"),
+    NOISEREPELLENT_PARAMETER_URI("smoothing"),
+    NOISEREPELLENT_PARAMETER_URI("residuallisten"),
+    NOISEREPELLENT_PARAMETER_URI("enable"),
+};
 
 typedef struct URIs {
   LV2_URID plugin;
+  LV2_URID atom_Bool;
+  LV2_URID atom_Float;
+  LV2_URID atom_Int;
+  LV2_URID atom_Object;
+  LV2_URID atom_URID;
+  LV2_URID patch_Set;
+  LV2_URID patch_property;
+  LV2_URID patch_value;
+  LV2_URID controls[NOISEREPELLENT_CONTROLS];
 } URIs;
 
 static void map_uris(LV2_URID_Map *map, URIs *uris, const char *uri) {
@@ -41,8 +89,22 @@ static void map_uris(LV2_URID_Map *map, URIs *uris, const char *uri) {
       strcmp(uri, NOISEREPELLENT_ADAPTIVE_URI)
           ? map->map(map->handle, NOISEREPELLENT_ADAPTIVE_URI)
           : map->map(map->handle, NOISEREPELLENT_ADAPTIVE_STEREO_URI);
+  uris->atom_Bool = map->map(map->handle, LV2_ATOM__Bool);
+  uris->atom_Float = map->map(map->handle, LV2_ATOM__Float);
+  uris->atom_Int = map->map(map->handle, LV2_ATOM__Int);
+  uris->atom_Object = map->map(map->handle, LV2_ATOM__Object);
+  uris->atom_URID = map->map(map->handle, LV2_ATOM__URID);
+  uris->patch_Set = map->map(map->handle, LV2_PATCH__Set);
+  uris->patch_property = map->map(map->handle, LV2_PATCH__property);
+  uris->patch_value = map->map(map->handle, LV2_PATCH__value);
+
+  for (uint32_t k = 0U; k < NOISEREPELLENT_CONTROLS; k++) {
+    uris->controls[k] = map->map(map->handle, control_parameters[k]);
+  }
 }
 
+// Every variant starts with the same controls followed by one input and output
+// pair per channel. The control port comes after the audio ports
 typedef enum PortIndex {
   NOISEREPELLENT_AMOUNT = 0,
   NOISEREPELLENT_NOISE_OFFSET = 1,
@@ -52,69 +114,333 @@ typedef enum PortIndex {
   NOISEREPELLENT_LATENCY = 5,
   NOISEREPELLENT_INPUT_1 = 6,
   NOISEREPELLENT_OUTPUT_1 = 7,
-  NOISEREPELLENT_INPUT_2 = 8,
-  NOISEREPELLENT_OUTPUT_2 = 9,
 } PortIndex;
 
+_Static_assert(NOISEREPELLENT_LATENCY == NOISEREPELLENT_CONTROLS,
+               "every port before the latency one is an automatable control");
+
+typedef struct PluginChannel {
+  const float *input;
+  float *output;
+  SpectralBleachHandle lib_instance;
+  SignalCrossfade *soft_bypass;
+} PluginChannel;
+
 typedef struct NoiseRepellentAdaptivePlugin {
-  const float *input_1;
-  const float *input_2;
-  float *output_1;
-  float *output_2;
+  const LV2_Atom_Sequence *control;
   float sample_rate;
   float *report_latency;
 
   LV2_URID_Map *map;
+  LV2_Worker_Schedule *schedule;
   LV2_Log_Logger log;
   URIs uris;
   char *plugin_uri;
 
-  SpectralBleachHandle lib_instance_1;
-  SpectralBleachHandle lib_instance_2;
-  SpectralBleachParameters parameters;
-  SignalCrossfade *soft_bypass;
+  PluginChannel *channels; // One contiguous record per channel
+  uint32_t number_of_channels;
+  uint32_t control_port;
+  uint32_t reduction_average_port;
+  uint32_t reduction_peak_port;
+  uint32_t parallel_port;
+  ControlAutomation *automation;
+  TimingTrace *timing_trace;
+  ReductionMeter *reduction_meter;
+  bool meter_due;
+  float *reduction_average;
+  float *reduction_peak;
+  float *parallel_channels;
+  uint32_t span_offset; // Start of the part of the block being processed
 
-  float *enable;
-  float *residual_listen;
-  float *reduction_amount;
-  float *smoothing_factor;
-  float *noise_rescale;
+  SpectralBleachParameters parameters;
+  bool parameters_changed;
+  bool parameters_loaded;
+  float *scratch_input;
+  float *scratch_output;
+  bool engine_idle;
+  ChannelWorker *parallel_worker;
+  _Atomic(ChannelWorker *) started_worker; // Left by the start job
+  uint32_t parallel_split;
+  bool parallel_start_scheduled; // Set once, a failed start is not retried
+  // What the helper works on, MAX_SPAN samples per channel it processes
+  float *parallel_input;
+  float *parallel_output;
+  SpectralBleachParameters parallel_parameters;
+  bool parallel_load_parameters;
 
 } NoiseRepellentAdaptivePlugin;
 
 static void cleanup(LV2_Handle instance) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
-  if (self->lib_instance_1) {
-    specbleach_adaptive_free(self->lib_instance_1);
+  // A helper started by a job whose completion never ran is only found here
+  ChannelWorker *started_worker =
+      atomic_exchange_explicit(&self->started_worker, NULL,
+                               memory_order_acquire);
+  if (started_worker) {
+    channel_worker_free(started_worker);
+  }
+  if (self->parallel_worker) {
+    channel_worker_free(self->parallel_worker);
   }
+  free(self->parallel_input);
+  free(self->parallel_output);
+
+  for (uint32_t c = 0U; self->channels && c < self->number_of_channels; c++) {
+    PluginChannel *channel = &self->channels[c];
 
-  if (self->lib_instance_2) {
-    specbleach_adaptive_free(self->lib_instance_2);
+    if (channel->lib_instance) {
+      specbleach_adaptive_free(channel->lib_instance);
+    }
+
+    if (channel->soft_bypass) {
+      signal_crossfade_free(channel->soft_bypass);
+    }
   }
+  free(self->channels);
 
   if (self->plugin_uri) {
     free(self->plugin_uri);
   }
 
-  if (self->soft_bypass) {
-    signal_crossfade_free(self->soft_bypass);
+  if (self->automation) {
+    control_automation_free(self->automation);
   }
 
+  if (self->timing_trace) {
+    timing_trace_free(self->timing_trace);
+  }
+
+  if (self->reduction_meter) {
+    reduction_meter_free(self->reduction_meter);
+  }
+
+  free(self->scratch_input);
+  free(self->scratch_output);
+
   free(instance);
 }
 
+static void process_channel(NoiseRepellentAdaptivePlugin *self,
+                            PluginChannel *channel,
+                            const uint32_t number_of_samples) {
+  if (self->parameters_changed) {
+    specbleach_adaptive_load_parameters(channel->lib_instance,
+                                        self->parameters);
+  }
+
+  specbleach_adaptive_process(channel->lib_instance, number_of_samples,
+                              channel->input + self->span_offset,
+                              channel->output + self->span_offset);
+}
+
+// Refills the engine with the latest input so it fades back in cleanly
+static void warm_up_channel(NoiseRepellentAdaptivePlugin *self,
+                            PluginChannel *channel) {
+  const uint32_t latency = signal_crossfade_get_latency(channel->soft_bypass);
+  if (latency == 0U) {
+    return;
+  }
+
+  signal_crossfade_get_dry_history(channel->soft_bypass, self->scratch_input);
+
+  specbleach_adaptive_load_parameters(channel->lib_instance, self->parameters);
+  specbleach_adaptive_process(channel->lib_instance, latency,
+                              self->scratch_input, self->scratch_output);
+}
+
+static bool atom_number(const NoiseRepellentAdaptivePlugin *self,
+                        const LV2_Atom *atom, float *number) {
+  if (!atom) {
+    return false;
+  }
+
+  if (atom->type == self->uris.atom_Float) {
+    *number = ((const LV2_Atom_Float *)atom)->body;
+  } else if (atom->type == self->uris.atom_Int) {
+    *number = (float)((const LV2_Atom_Int *)atom)->body;
+  } else if (atom->type == self->uris.atom_Bool) {
+    *number = ((const LV2_Atom_Bool *)atom)->body ? 1.F : 0.F;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+static void process_control_event(NoiseRepellentAdaptivePlugin *self,
+                                  const LV2_Atom_Event *event) {
+  const LV2_Atom_Object *object = (const LV2_Atom_Object *)&event->body;
+  if (event->body.type != self->uris.atom_Object ||
+      object->body.otype != self->uris.patch_Set) {
+    return;
+  }
+
+  const LV2_Atom_URID *property = NULL;
+  const LV2_Atom *value = NULL;
+  // clang-format off
+  lv2_atom_object_get(object,
+                      self->uris.patch_property, &property,
+                      self->uris.patch_value, &value,
+                      0);
+  // clang-format on
+
+  if (!property || property->atom.type != self->uris.atom_URID) {
+    return;
+  }
+
+  float number = 0.F;
+  for (uint32_t k = 0U; k < NOISEREPELLENT_CONTROLS; k++) {
+    if (property->body == self->uris.controls[k] &&
+        atom_number(self, value, &number)) {
+      control_automation_set(self->automation, k, number);
+      return;
+    }
+  }
+}
+
+static float control_value(const NoiseRepellentAdaptivePlugin *self,
+                           const PortIndex port) {
+  return control_automation_get(self->automation, (uint32_t)port);
+}
+
+static bool engine_bypassed(const NoiseRepellentAdaptivePlugin *self) {
+  return !(bool)control_value(self, NOISEREPELLENT_ENABLE) &&
+         signal_crossfade_is_bypassed(self->channels[0].soft_bypass);
+}
+
+static void process_channels(NoiseRepellentAdaptivePlugin *self,
+                             const uint32_t first, const uint32_t last,
+                             const uint32_t number_of_samples) {
+  for (uint32_t c = first; c < last; c++) {
+    process_channel(self, &self->channels[c], number_of_samples);
+  }
+}
+
+static void process_parallel_channels(void *data,
+                                      const uint32_t number_of_samples) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)data;
+
+  for (uint32_t c = self->parallel_split; c < self->number_of_channels; c++) {
+    SpectralBleachHandle lib_instance = self->channels[c].lib_instance;
+    const uint32_t k = (c - self->parallel_split) * MAX_SPAN;
+
+    if (self->parallel_load_parameters) {
+      specbleach_adaptive_load_parameters(lib_instance,
+                                          self->parallel_parameters);
+    }
+    specbleach_adaptive_process(lib_instance, number_of_samples,
+                                self->parallel_input + k,
+                                self->parallel_output + k);
+  }
+}
+
+// The helper keeps its channels past a missed deadline until it is done, and
+// no engine is touched in the meantime
+static bool helper_busy(const NoiseRepellentAdaptivePlugin *self) {
+  return self->parallel_worker && channel_worker_busy(self->parallel_worker);
+}
+
+// The helper only reads and writes copies of its channels, so a job left to
+// it at a missed deadline can finish after run() returned. Returns false then
+static bool process_in_parallel(NoiseRepellentAdaptivePlugin *self,
+                                const uint32_t number_of_samples) {
+  const uint32_t split = self->parallel_split;
+
+  self->parallel_parameters = self->parameters;
+  self->parallel_load_parameters = self->parameters_changed;
+  for (uint32_t c = split; c < self->number_of_channels; c++) {
+    memcpy(self->parallel_input + (c - split) * MAX_SPAN,
+           self->channels[c].input + self->span_offset,
+           sizeof(float) * number_of_samples);
+  }
+
+  channel_worker_dispatch(self->parallel_worker, number_of_samples);
+  process_channels(self, 0U, split, number_of_samples);
+  if (!channel_worker_join(self->parallel_worker)) {
+    return false;
+  }
+
+  for (uint32_t c = split; c < self->number_of_channels; c++) {
+    memcpy(self->channels[c].output + self->span_offset,
+           self->parallel_output + (c - split) * MAX_SPAN,
+           sizeof(float) * number_of_samples);
+  }
+  return true;
+}
+
+// Every channel passes the delayed dry signal without touching its engine,
+// and the engines are refilled once processing resumes
+static void output_dry(NoiseRepellentAdaptivePlugin *self,
+                       const uint32_t number_of_samples) {
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    PluginChannel *channel = &self->channels[c];
+
+    signal_crossfade_bypass(channel->soft_bypass, number_of_samples,
+                            channel->input + self->span_offset,
+                            channel->output + self->span_offset);
+  }
+  self->engine_idle = true;
+}
+
+// Spawning the helper thread is left to the worker, so turning the port on
+// never blocks the audio thread
+static void start_parallel_work(LV2_Handle instance, WorkerJob *job) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  ChannelWorker *worker = channel_worker_initialize(process_parallel_channels,
+                                                    self, self->sample_rate);
+  if (!worker) {
+    lv2_log_warning(&self->log, "Processing <%s> channels serially\n",
+                    self->plugin_uri);
+    return;
+  }
+  atomic_store_explicit(&self->started_worker, worker, memory_order_release);
+}
+
+static void start_parallel_complete(LV2_Handle instance, WorkerJob *job) {
+  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+
+  self->parallel_worker = atomic_exchange_explicit(
+      &self->started_worker, NULL, memory_order_acquire);
+}
+
+static bool parallel_enabled(NoiseRepellentAdaptivePlugin *self) {
+  if (!self->parallel_channels || !(bool)*self->parallel_channels) {
+    return false;
+  }
+
+  if (!self->parallel_start_scheduled) {
+    self->parallel_start_scheduled = worker_job_schedule(
+        self->schedule, start_parallel_work, start_parallel_complete, NULL);
+  }
+
+  return self->parallel_worker != NULL;
+}
+
+static uint32_t channels_for(const char *uri) {
+  if (strcmp(uri, NOISEREPELLENT_ADAPTIVE_STEREO_URI) == 0) {
+    return 2U;
+  }
+  if (strcmp(uri, NOISEREPELLENT_ADAPTIVE_MULTICHANNEL_URI) == 0) {
+    return NOISEREPELLENT_MULTICHANNEL_CHANNELS;
+  }
+  return 1U;
+}
+
 static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
                               const double rate, const char *bundle_path,
                               const LV2_Feature *const *features) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)calloc(
       1U, sizeof(NoiseRepellentAdaptivePlugin));
+  atomic_init(&self->started_worker, NULL);
 
   // clang-format off
   const char *missing =
       lv2_features_query(features,
                          LV2_LOG__log, &self->log.log, false,
                          LV2_URID__map, &self->map, true,
+                         LV2_WORKER__schedule, &self->schedule, false,
                          NULL);
   // clang-format on
 
@@ -126,139 +452,352 @@ static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
     return NULL;
   }
 
-  if (strstr(descriptor->URI, NOISEREPELLENT_ADAPTIVE_URI)) {
-    self->plugin_uri = (char *)calloc(
-        strlen(NOISEREPELLENT_ADAPTIVE_STEREO_URI) + 1, sizeof(char));
-    strcpy(self->plugin_uri, descriptor->URI);
-  } else {
-    self->plugin_uri =
-        (char *)calloc(strlen(NOISEREPELLENT_ADAPTIVE_URI) + 1, sizeof(char));
-    strcpy(self->plugin_uri, descriptor->URI);
+  lv2_log_trace(&self->log, "Running %s kernels\n",
+                cpu_dispatch_level_name(cpu_dispatch_level()));
+
+  self->plugin_uri =
+      (char *)calloc(strlen(descriptor->URI) + 1U, sizeof(char));
+  strcpy(self->plugin_uri, descriptor->URI);
+
+  self->automation = control_automation_initialize(NOISEREPELLENT_CONTROLS);
+  if (!self->automation) {
+    cleanup((LV2_Handle)self);
+    return NULL;
   }
 
+  self->number_of_channels = channels_for(self->plugin_uri);
+  self->control_port = NOISEREPELLENT_INPUT_1 + 2U * self->number_of_channels;
+  self->reduction_average_port = self->control_port + 1U;
+  self->reduction_peak_port = self->control_port + 2U;
+  self->parallel_port =
+      self->number_of_channels > 1U ? self->control_port + 3U : UINT32_MAX;
+  // The helper thread takes the upper half of the channels
+  self->parallel_split = (self->number_of_channels + 1U) / 2U;
+
   map_uris(self->map, &self->uris, self->plugin_uri);
 
   self->sample_rate = (float)rate;
 
-  self->lib_instance_1 =
-      specbleach_adaptive_initialize((uint32_t)self->sample_rate);
-  if (!self->lib_instance_1) {
+  self->channels = (PluginChannel *)calloc(self->number_of_channels,
+                                           sizeof(PluginChannel));
+  if (!self->channels) {
     cleanup((LV2_Handle)self);
     return NULL;
   }
 
-  self->soft_bypass = signal_crossfade_initialize((uint32_t)self->sample_rate);
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    PluginChannel *channel = &self->channels[c];
 
-  if (!self->soft_bypass) {
+    channel->lib_instance =
+        specbleach_adaptive_initialize((uint32_t)self->sample_rate);
+    if (!channel->lib_instance) {
+      lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+      cleanup((LV2_Handle)self);
+      return NULL;
+    }
+
+    channel->soft_bypass = signal_crossfade_initialize(
+        (uint32_t)self->sample_rate,
+        specbleach_adaptive_get_latency(channel->lib_instance));
+    if (!channel->soft_bypass) {
+      cleanup((LV2_Handle)self);
+      return NULL;
+    }
+  }
+
+  const uint32_t latency =
+      specbleach_adaptive_get_latency(self->channels[0].lib_instance);
+  self->scratch_input = (float *)calloc(latency + 1U, sizeof(float));
+  self->scratch_output = (float *)calloc(latency + 1U, sizeof(float));
+  self->reduction_meter =
+      reduction_meter_initialize((uint32_t)self->sample_rate);
+
+  if (!self->scratch_input || !self->scratch_output ||
+      !self->reduction_meter) {
     cleanup((LV2_Handle)self);
     return NULL;
   }
 
-  if (strstr(self->plugin_uri, NOISEREPELLENT_ADAPTIVE_STEREO_URI)) {
-    self->lib_instance_2 =
-        specbleach_adaptive_initialize((uint32_t)self->sample_rate);
-
-    if (!self->lib_instance_2) {
-      lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+  if (self->parallel_port != UINT32_MAX) {
+    const uint32_t helper_channels =
+        self->number_of_channels - self->parallel_split;
+    self->parallel_input =
+        (float *)calloc(helper_channels * MAX_SPAN, sizeof(float));
+    self->parallel_output =
+        (float *)calloc(helper_channels * MAX_SPAN, sizeof(float));
+    if (!self->parallel_input || !self->parallel_output) {
       cleanup((LV2_Handle)self);
       return NULL;
     }
   }
 
+  self->timing_trace =
+      timing_trace_initialize(self->plugin_uri, (uint32_t)self->sample_rate);
+
   return (LV2_Handle)self;
 }
 
 static void connect_port(LV2_Handle instance, uint32_t port, void *data) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
-  switch ((PortIndex)port) {
-  case NOISEREPELLENT_AMOUNT:
-    self->reduction_amount = (float *)data;
-    break;
-  case NOISEREPELLENT_NOISE_OFFSET:
-    self->noise_rescale = (float *)data;
-    break;
-  case NOISEREPELLENT_NOISE_SMOOTHING:
-    self->smoothing_factor = (float *)data;
-    break;
-  case NOISEREPELLENT_RESIDUAL_LISTEN:
-    self->residual_listen = (float *)data;
-    break;
-  case NOISEREPELLENT_ENABLE:
-    self->enable = (float *)data;
-    break;
-  case NOISEREPELLENT_LATENCY:
+  if (port < NOISEREPELLENT_CONTROLS) {
+    control_automation_connect(self->automation, port, (const float *)data);
+  } else if (port == NOISEREPELLENT_LATENCY) {
     self->report_latency = (float *)data;
-    break;
-  case NOISEREPELLENT_INPUT_1:
-    self->input_1 = (const float *)data;
-    break;
-  case NOISEREPELLENT_OUTPUT_1:
-    self->output_1 = (float *)data;
-    break;
-  default:
-    break;
+  } else if (port == self->control_port) {
+    self->control = (const LV2_Atom_Sequence *)data;
+  } else if (port == self->reduction_average_port) {
+    self->reduction_average = (float *)data;
+  } else if (port == self->reduction_peak_port) {
+    self->reduction_peak = (float *)data;
+  } else if (port == self->parallel_port) {
+    self->parallel_channels = (float *)data;
+  } else if (port >= NOISEREPELLENT_INPUT_1 &&
+             port < NOISEREPELLENT_INPUT_1 + 2U * self->number_of_channels) {
+    PluginChannel *channel =
+        &self->channels[(port - NOISEREPELLENT_INPUT_1) / 2U];
+
+    if ((port - NOISEREPELLENT_INPUT_1) % 2U == 0U) {
+      channel->input = (const float *)data;
+    } else {
+      channel->output = (float *)data;
+    }
   }
 }
 
-static void connect_port_stereo(LV2_Handle instance, uint32_t port,
-                                void *data) {
-  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
-
-  connect_port(instance, port, data);
-
-  switch ((PortIndex)port) {
-  case NOISEREPELLENT_INPUT_2:
-    self->input_2 = (const float *)data;
-    break;
-  case NOISEREPELLENT_OUTPUT_2:
-    self->output_2 = (float *)data;
-    break;
-  default:
-    break;
+// The latency port is an output, so it is written on every block and not
+// only when the host happens to read it after activate()
+static void publish_latency(NoiseRepellentAdaptivePlugin *self) {
+  if (self->report_latency) {
+    *self->report_latency =
+        (float)specbleach_adaptive_get_latency(self->channels[0].lib_instance);
   }
 }
 
 static void activate(LV2_Handle instance) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
 
-  *self->report_latency =
-      (float)specbleach_adaptive_get_latency(self->lib_instance_1);
+  publish_latency(self);
 }
 
-static void run(LV2_Handle instance, uint32_t number_of_samples) {
-  NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+static float smooth_parameter(const float current, const float target,
+                              const float coefficient) {
+  if (fabsf(target - current) < PARAMETER_SETTLE_THRESHOLD) {
+    return target;
+  }
+  return current + coefficient * (target - current);
+}
 
+static SpectralBleachParameters
+target_parameters(const NoiseRepellentAdaptivePlugin *self) {
   // clang-format off
-  self->parameters = (SpectralBleachParameters){
-      .residual_listen = (bool)*self->residual_listen,
-      .reduction_amount = *self->reduction_amount,
-      .smoothing_factor = *self->smoothing_factor,
-      .noise_rescale = *self->noise_rescale
+  return (SpectralBleachParameters){
+      .residual_listen =
+          (bool)control_value(self, NOISEREPELLENT_RESIDUAL_LISTEN),
+      .reduction_amount = control_value(self, NOISEREPELLENT_AMOUNT),
+      .smoothing_factor = control_value(self, NOISEREPELLENT_NOISE_SMOOTHING),
+      .noise_rescale = control_value(self, NOISEREPELLENT_NOISE_OFFSET)
   };
   // clang-format on
+}
+
+// Continuous parameters still on their way to the port values
+static bool parameters_gliding(const NoiseRepellentAdaptivePlugin *self) {
+  const SpectralBleachParameters target = target_parameters(self);
+  const SpectralBleachParameters *current = &self->parameters;
+
+  return self->parameters_loaded &&
+         (target.reduction_amount != current->reduction_amount ||
+          target.smoothing_factor != current->smoothing_factor ||
+          target.noise_rescale != current->noise_rescale);
+}
+
+// Parameters only reach the engines when a port moved. Continuous ones glide
+// towards their target so automation does not zipper
+static void update_parameters(NoiseRepellentAdaptivePlugin *self,
+                              const uint32_t number_of_samples) {
+  const SpectralBleachParameters target = target_parameters(self);
+  SpectralBleachParameters *current = &self->parameters;
+
+  if (!self->parameters_loaded) {
+    *current = target;
+    self->parameters_changed = true;
+    self->parameters_loaded = true;
+    return;
+  }
+
+  const bool toggles_changed =
+      target.residual_listen != current->residual_listen;
+  const bool values_changed =
+      target.reduction_amount != current->reduction_amount ||
+      target.smoothing_factor != current->smoothing_factor ||
+      target.noise_rescale != current->noise_rescale;
+
+  self->parameters_changed = toggles_changed || values_changed;
+  if (!self->parameters_changed) {
+    return;
+  }
+
+  current->residual_listen = target.residual_listen;
+
+  if (values_changed) {
+    const float coefficient =
+        1.F - expf(-(float)number_of_samples /
+                   (PARAMETER_SMOOTHING_MS * 0.001F * self->sample_rate));
 
-  specbleach_adaptive_load_parameters(self->lib_instance_1, self->parameters);
+    current->reduction_amount = smooth_parameter(
+        current->reduction_amount, target.reduction_amount, coefficient);
+    current->smoothing_factor = smooth_parameter(
+        current->smoothing_factor, target.smoothing_factor, coefficient);
+    current->noise_rescale = smooth_parameter(
+        current->noise_rescale, target.noise_rescale, coefficient);
+  }
+}
+
+// Processes part of the block with the control values in effect at its start
+static void run_span(NoiseRepellentAdaptivePlugin *self, const uint32_t offset,
+                     const uint32_t number_of_samples) {
+  self->span_offset = offset;
+  if (helper_busy(self)) {
+    output_dry(self, number_of_samples);
+    return;
+  }
+
+  update_parameters(self, number_of_samples);
+
+  if (engine_bypassed(self)) {
+    for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+      PluginChannel *channel = &self->channels[c];
 
-  specbleach_adaptive_process(self->lib_instance_1, number_of_samples,
-                              self->input_1, self->output_1);
+      signal_crossfade_bypass(channel->soft_bypass, number_of_samples,
+                              channel->input + offset,
+                              channel->output + offset);
+    }
+    timing_trace_lap(self->timing_trace, TIMING_SECTION_CROSSFADE);
+    self->engine_idle = true;
+    return;
+  }
+
+  if (self->engine_idle) {
+    for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+      warm_up_channel(self, &self->channels[c]);
+    }
+    self->engine_idle = false;
+  }
 
-  signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_1,
-                       self->output_1, (bool)*self->enable);
+  if (parallel_enabled(self)) {
+    // The upper half of the channels overlaps with the lower one
+    if (!process_in_parallel(self, number_of_samples)) {
+      output_dry(self, number_of_samples);
+      return;
+    }
+  } else {
+    process_channels(self, 0U, self->number_of_channels, number_of_samples);
+  }
+
+  timing_trace_lap(self->timing_trace, TIMING_SECTION_PROCESS);
+  // The input is read again after the engines wrote the output, which is why
+  // the bundles declare lv2:inPlaceBroken
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    PluginChannel *channel = &self->channels[c];
+
+    if (self->meter_due) {
+      float dry_energy = 0.F;
+      float wet_energy = 0.F;
+      signal_crossfade_measure(channel->soft_bypass, number_of_samples,
+                               channel->input + offset,
+                               channel->output + offset, &dry_energy,
+                               &wet_energy);
+      reduction_meter_add(self->reduction_meter, dry_energy, wet_energy);
+    }
+
+    signal_crossfade_run(channel->soft_bypass, number_of_samples,
+                         channel->input + offset, channel->output + offset,
+                         (bool)control_value(self, NOISEREPELLENT_ENABLE));
+  }
+  timing_trace_lap(self->timing_trace, TIMING_SECTION_CROSSFADE);
 }
 
-static void run_stereo(LV2_Handle instance, uint32_t number_of_samples) {
+// Spans longer than the helper's copies are processed in pieces, and while
+// parameters glide in pieces short enough that no single step is audible
+static void run_spans(NoiseRepellentAdaptivePlugin *self, uint32_t offset,
+                      uint32_t number_of_samples) {
+  while (number_of_samples > 0U) {
+    const uint32_t limit =
+        parameters_gliding(self) ? PARAMETER_STEP_SAMPLES : MAX_SPAN;
+    const uint32_t span =
+        number_of_samples < limit ? number_of_samples : limit;
+    run_span(self, offset, span);
+    offset += span;
+    number_of_samples -= span;
+  }
+}
+
+// Meters are refreshed at a bounded rate, the ports keep their last value in
+// between
+static void publish_meters(NoiseRepellentAdaptivePlugin *self) {
+  if (self->meter_due) {
+    reduction_meter_update(self->reduction_meter);
+  }
+
+  if (self->reduction_average) {
+    *self->reduction_average =
+        reduction_meter_get_average(self->reduction_meter);
+  }
+  if (self->reduction_peak) {
+    *self->reduction_peak = reduction_meter_get_peak(self->reduction_meter);
+  }
+}
+
+// Events split the block so automation lands on the sample it was written
+// for. The engines take any number of samples, so nothing is buffered here
+static void run(LV2_Handle instance, uint32_t number_of_samples) {
   NoiseRepellentAdaptivePlugin *self = (NoiseRepellentAdaptivePlugin *)instance;
+  timing_trace_begin(self->timing_trace);
 
-  run(instance, number_of_samples); // Call left side first
+  publish_latency(self);
+  if (self->parallel_worker) {
+    channel_worker_begin_block(self->parallel_worker, number_of_samples);
+  }
+  control_automation_read_ports(self->automation);
+  self->meter_due =
+      reduction_meter_start_block(self->reduction_meter, number_of_samples);
+
+  DenormalGuard denormal_guard;
+  denormal_guard_enter(&denormal_guard);
+
+  uint32_t offset = 0U;
+  if (self->control) {
+    LV2_ATOM_SEQUENCE_FOREACH(self->control, event) {
+      const uint32_t frame = event->time.frames < number_of_samples
+                                 ? (uint32_t)event->time.frames
+                                 : number_of_samples;
+      if (frame > offset) {
+        run_spans(self, offset, frame - offset);
+        offset = frame;
+      }
+
+      process_control_event(self, event);
+    }
+  }
 
-  specbleach_adaptive_load_parameters(self->lib_instance_2, self->parameters);
+  if (offset < number_of_samples) {
+    run_spans(self, offset, number_of_samples - offset);
+  }
 
-  specbleach_adaptive_process(self->lib_instance_2, number_of_samples,
-                              self->input_2, self->output_2);
+  publish_meters(self);
+  denormal_guard_leave(&denormal_guard);
+
+  timing_trace_commit(self->timing_trace, number_of_samples);
+}
 
-  signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_2,
-                       self->output_2, (bool)*self->enable);
+static const void *extension_data(const char *uri) {
+  static const LV2_Worker_Interface worker = {worker_job_work,
+                                              worker_job_work_response, NULL};
+  if (strcmp(uri, LV2_WORKER__interface) == 0) {
+    return &worker;
+  }
+  return NULL;
 }
 
 // clang-format off
@@ -270,18 +809,29 @@ static const LV2_Descriptor descriptor_adaptive = {
     run,
     NULL,
     cleanup,
-    NULL
+    extension_data
 };
 
 static const LV2_Descriptor descriptor_adaptive_stereo = {
     NOISEREPELLENT_ADAPTIVE_STEREO_URI,
     instantiate,
-    connect_port_stereo,
+    connect_port,
     activate,
-    run_stereo,
+    run,
+    NULL,
+    cleanup,
+    extension_data
+};
+
+static const LV2_Descriptor descriptor_adaptive_multichannel = {
+    NOISEREPELLENT_ADAPTIVE_MULTICHANNEL_URI,
+    instantiate,
+    connect_port,
+    activate,
+    run,
     NULL,
     cleanup,
-    NULL
+    extension_data
 };
 // clang-format on
 
@@ -291,6 +841,8 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor *lv2_descriptor(uint32_t index) {
     return &descriptor_adaptive;
   case 1:
     return &descriptor_adaptive_stereo;
+  case 2:
+    return &descriptor_adaptive_multichannel;
   default:
     return NULL;
   }
@@ -18,69 +18,169 @@ along with this program; if not, write to the Free Software Foundation,
 Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
+#include "../src/channel_worker.h"
+#include "../src/control_automation.h"
+#include "../src/cpu_dispatch.h"
+#include "../src/denormal_guard.h"
 #include "../src/noise_profile_state.h"
+#include "../src/profile_exchange.h"
+#include "../src/profile_library.h"
+#include "../src/reduction_meter.h"
 #include "../src/signal_crossfade.h"
+#include "../src/spectrum_decimator.h"
+#include "../src/timing_trace.h"
+#include "../src/worker_job.h"
 
 #include "lv2/atom/atom.h"
+#include "lv2/atom/forge.h"
+#include "lv2/atom/util.h"
 #include "lv2/core/lv2.h"
 #include "lv2/core/lv2_util.h"
 #include "lv2/log/logger.h"
+#include "lv2/patch/patch.h"
 #include "lv2/state/state.h"
 #include "lv2/urid/urid.h"
+#include "lv2/worker/worker.h"
 #include "specbleach_denoiser.h"
+#include <math.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define PARAMETER_SMOOTHING_MS 50.F
+#define PARAMETER_SETTLE_THRESHOLD 1e-3F
+#define PARAMETER_STEP_SAMPLES 128U // Longest span while parameters glide
+#define MAX_CHANNELS 16U
+#define SPECTRUM_BANDS 64U
+#define MAX_SPAN 2048U // Longest span processed at once, sizes helper copies
+
+// Width of the multichannel variant, set by the build
+#ifndef NOISEREPELLENT_MULTICHANNEL_CHANNELS
+#define NOISEREPELLENT_MULTICHANNEL_CHANNELS 8U
+#endif
+
+_Static_assert(NOISEREPELLENT_MULTICHANNEL_CHANNELS <= MAX_CHANNELS,
+               "Too many channels for the multichannel variant");
+
 #define NOISEREPELLENT_URI "https://github.com/lucianodato/noise-repellent#new"
 #define NOISEREPELLENT_STEREO_URI                                              \
   "https://github.com/lucianodato/noise-repellent-stereo#new"
+#define NOISEREPELLENT_MULTICHANNEL_URI                                        \
+  "https://github.com/lucianodato/noise-repellent-multichannel#new"
+#define NOISEREPELLENT_PROFILE_URI                                             \
+  "https://github.com/lucianodato/noise-repellent#profile"
+#define NOISEREPELLENT_STORE_PROFILE_URI                                       \
+  "https://github.com/lucianodato/noise-repellent#storeprofile"
+#define NOISEREPELLENT_SPECTRUM_URI                                            \
+  "https://github.com/lucianodato/noise-repellent#Spectrum"
+#define NOISEREPELLENT_NOISE_SPECTRUM_URI                                      \
+  "https://github.com/lucianodato/noise-repellent#noisespectrum"
+
+// Control inputs can also be set through timestamped patch:Set events on the
+// control port, each one is a parameter named after the port
+#define NOISEREPELLENT_CONTROLS 9U
+#define NOISEREPELLENT_PARAMETER_URI(name)                                     \
+  "https://github.com/lucianodato/noise-repellent#" name
+
+static const char *const control_parameters[NOISEREPELLENT_CONTROLS] = {
+    NOISEREPELLENT_PARAMETER_URI("reduction"),
+    NOISEREPELLENT_PARAMETER_URI("offset"),
+    NOISEREPELLENT_PARAMETER_URI("smoothing"),
+    NOISEREPELLENT_PARAMETER_URI("whitening"),
+    NOISEREPELLENT_PARAMETER_URI("transientprotection"),
+    NOISEREPELLENT_PARAMETER_URI("learn"),
+    NOISEREPELLENT_PARAMETER_URI("residuallisten"),
+    NOISEREPELLENT_PARAMETER_URI("resetprofile"),
+    NOISEREPELLENT_PARAMETER_URI("enable"),
+};
 
 typedef struct URIs {
+  LV2_URID atom_Bool;
   LV2_URID atom_Int;
   LV2_URID atom_Float;
   LV2_URID atom_Vector;
   LV2_URID plugin;
   LV2_URID atom_URID;
+  LV2_URID atom_Object;
+  LV2_URID atom_String;
+  LV2_URID patch_Set;
+  LV2_URID patch_property;
+  LV2_URID patch_value;
+  LV2_URID profile;
+  LV2_URID store_profile;
+  LV2_URID spectrum;
+  LV2_URID noise_spectrum;
+  LV2_URID controls[NOISEREPELLENT_CONTROLS];
 } URIs;
 
 typedef struct State {
-  LV2_URID property_noise_profile_1;
-  LV2_URID property_noise_profile_2;
+  LV2_URID property_noise_profiles[MAX_CHANNELS];
   LV2_URID property_noise_profile_size;
   LV2_URID property_averaged_blocks;
+  LV2_URID property_version;
+  LV2_URID property_sample_rate;
+  LV2_URID property_fft_size;
 } State;
 
 static void map_uris(LV2_URID_Map *map, URIs *uris, const char *uri) {
   uris->plugin = strcmp(uri, NOISEREPELLENT_URI)
                      ? map->map(map->handle, NOISEREPELLENT_URI)
                      : map->map(map->handle, NOISEREPELLENT_STEREO_URI);
+  uris->atom_Bool = map->map(map->handle, LV2_ATOM__Bool);
   uris->atom_Int = map->map(map->handle, LV2_ATOM__Int);
   uris->atom_Float = map->map(map->handle, LV2_ATOM__Float);
   uris->atom_Vector = map->map(map->handle, LV2_ATOM__Vector);
   uris->atom_URID = map->map(map->handle, LV2_ATOM__URID);
+  uris->atom_Object = map->map(map->handle, LV2_ATOM__Object);
+  uris->atom_String = map->map(map->handle, LV2_ATOM__String);
+  uris->patch_Set = map->map(map->handle, LV2_PATCH__Set);
+  uris->patch_property = map->map(map->handle, LV2_PATCH__property);
+  uris->patch_value = map->map(map->handle, LV2_PATCH__value);
+  uris->profile = map->map(map->handle, NOISEREPELLENT_PROFILE_URI);
+  uris->store_profile =
+      map->map(map->handle, NOISEREPELLENT_STORE_PROFILE_URI);
+  uris->spectrum = map->map(map->handle, NOISEREPELLENT_SPECTRUM_URI);
+  uris->noise_spectrum =
+      map->map(map->handle, NOISEREPELLENT_NOISE_SPECTRUM_URI);
+
+  for (uint32_t k = 0U; k < NOISEREPELLENT_CONTROLS; k++) {
+    uris->controls[k] = map->map(map->handle, control_parameters[k]);
+  }
 }
 
-static void map_state(LV2_URID_Map *map, State *state, const char *uri) {
-  if (!strcmp(uri, NOISEREPELLENT_URI)) {
-    state->property_noise_profile_1 =
-        map->map(map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofile");
-    state->property_noise_profile_2 =
-        map->map(map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofile");
-    state->property_noise_profile_size =
-        map->map(map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofilesize");
-    state->property_averaged_blocks = map->map(
-        map->handle, NOISEREPELLENT_STEREO_URI "#noiseprofileaveragedblocks");
-
-  } else {
-    state->property_noise_profile_1 =
-        map->map(map->handle, NOISEREPELLENT_URI "#noiseprofile");
-    state->property_noise_profile_size =
-        map->map(map->handle, NOISEREPELLENT_URI "#noiseprofilesize");
-    state->property_averaged_blocks =
-        map->map(map->handle, NOISEREPELLENT_URI "#noiseprofileaveragedblocks");
+// Mono sessions have always been saved under the stereo URI and stereo ones
+// under the mono URI, the keys stay that way so old sessions still load
+static void map_state(LV2_URID_Map *map, State *state, const char *prefix,
+                      const uint32_t number_of_channels) {
+  char key[256];
+
+  for (uint32_t c = 0U; c < number_of_channels; c++) {
+    if (c == 0U) {
+      snprintf(key, sizeof(key), "%s#noiseprofile", prefix);
+    } else {
+      snprintf(key, sizeof(key), "%s#noiseprofile%u", prefix,
+               (unsigned int)(c + 1U));
+    }
+    state->property_noise_profiles[c] = map->map(map->handle, key);
   }
+
+  snprintf(key, sizeof(key), "%s#noiseprofilesize", prefix);
+  state->property_noise_profile_size = map->map(map->handle, key);
+  snprintf(key, sizeof(key), "%s#noiseprofileaveragedblocks", prefix);
+  state->property_averaged_blocks = map->map(map->handle, key);
+  snprintf(key, sizeof(key), "%s#noiseprofileversion", prefix);
+  state->property_version = map->map(map->handle, key);
+  snprintf(key, sizeof(key), "%s#noiseprofilesamplerate", prefix);
+  state->property_sample_rate = map->map(map->handle, key);
+  snprintf(key, sizeof(key), "%s#noiseprofilefftsize", prefix);
+  state->property_fft_size = map->map(map->handle, key);
 }
 
+// Every variant starts with the same controls followed by one input and output
+// pair per channel. Linking (when there is more than one channel), the
+// control port, the reduction meters and the notify port come after the audio
+// ports
 typedef enum PortIndex {
   NOISEREPELLENT_AMOUNT = 0,
   NOISEREPELLENT_NOISE_OFFSET = 1,
@@ -94,89 +194,559 @@ typedef enum PortIndex {
   NOISEREPELLENT_LATENCY = 9,
   NOISEREPELLENT_INPUT_1 = 10,
   NOISEREPELLENT_OUTPUT_1 = 11,
-  NOISEREPELLENT_INPUT_2 = 12,
-  NOISEREPELLENT_OUTPUT_2 = 13,
 } PortIndex;
 
+_Static_assert(NOISEREPELLENT_LATENCY == NOISEREPELLENT_CONTROLS,
+               "every port before the latency one is an automatable control");
+
+typedef struct PluginChannel {
+  const float *input;
+  float *output;
+  SpectralBleachHandle lib_instance;
+  SignalCrossfade *soft_bypass;
+  NoiseProfileState *noise_profile_state;
+} PluginChannel;
+
 typedef struct NoiseRepellentPlugin {
-  const float *input_1;
-  const float *input_2;
-  float *output_1;
-  float *output_2;
+  const LV2_Atom_Sequence *control;
+  LV2_Atom_Sequence *notify;
+  LV2_Atom_Forge forge;
+  LV2_Atom_Forge_Frame notify_frame;
   float sample_rate;
   float *report_latency;
 
   LV2_URID_Map *map;
+  LV2_Worker_Schedule *schedule;
   LV2_Log_Logger log;
   URIs uris;
   State state;
   char *plugin_uri;
 
-  SignalCrossfade *soft_bypass;
-  SpectralBleachHandle lib_instance_1;
-  SpectralBleachHandle lib_instance_2;
+  PluginChannel *channels; // One contiguous record per channel
+  uint32_t number_of_channels;
+  uint32_t control_port;
+  uint32_t reduction_average_port;
+  uint32_t reduction_peak_port;
+  uint32_t notify_port;
+  uint32_t parallel_port;
+  ControlAutomation *automation;
+  TimingTrace *timing_trace;
+  ReductionMeter *reduction_meter;
+  SpectrumDecimator *noise_spectrum;
+  bool meter_due;
+  bool noise_spectrum_changed;
+  uint32_t span_offset; // Start of the part of the block being processed
+
+  float *scratch_input;
+  float *scratch_output;
+  bool engine_idle;
+  ChannelWorker *parallel_worker;
+  _Atomic(ChannelWorker *) started_worker; // Left by the start job
+  uint32_t parallel_split;
+  bool parallel_start_scheduled; // Set once, a failed start is not retried
+  // What the helper works on, MAX_SPAN samples per channel it processes
+  float *parallel_input;
+  float *parallel_output;
+  SpectralBleachParameters parallel_parameters;
+  bool parallel_load_parameters;
+  bool parallel_reset;
   SpectralBleachParameters parameters;
-  NoiseProfileState *noise_profile_state_1;
-  NoiseProfileState *noise_profile_state_2;
-  float *noise_profile_1;
-  float *noise_profile_2;
+  bool parameters_changed;
+  bool parameters_loaded;
+  bool reset_requested;
+  bool was_reset;
+  ProfileExchange *restored_profile;
+  ProfileLibrary *profile_library;
+  ProfileLibrary *retired_library;
+  char *library_path;
+  bool library_refresh_pending;
+  char requested_profile[PROFILE_LIBRARY_NAME_SIZE];
+  bool profile_store_pending;
+  char store_name[PROFILE_LIBRARY_NAME_SIZE];
+  float *store_profile;
+  uint32_t store_averaged_blocks;
   uint32_t profile_size;
 
-  float *enable;
-  float *learn_noise;
-  float *transient_protection;
-  float *residual_listen;
-  float *reduction_amount;
-  float *smoothing_factor;
-  float *whitening_factor;
-  float *noise_rescale;
-  float *reset_noise_profile;
+  float *parallel_channels;
+  float *reduction_average;
+  float *reduction_peak;
 
 } NoiseRepellentPlugin;
 
 static void cleanup(LV2_Handle instance) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
-  if (self->noise_profile_state_1) {
-    noise_profile_state_free(self->noise_profile_state_1);
-    free(self->noise_profile_1);
+  // A helper started by a job whose completion never ran is only found here
+  ChannelWorker *started_worker =
+      atomic_exchange_explicit(&self->started_worker, NULL,
+                               memory_order_acquire);
+  if (started_worker) {
+    channel_worker_free(started_worker);
+  }
+  if (self->parallel_worker) {
+    channel_worker_free(self->parallel_worker);
+  }
+  free(self->parallel_input);
+  free(self->parallel_output);
+
+  for (uint32_t c = 0U; self->channels && c < self->number_of_channels; c++) {
+    PluginChannel *channel = &self->channels[c];
+
+    if (channel->lib_instance) {
+      specbleach_free(channel->lib_instance);
+    }
+
+    if (channel->soft_bypass) {
+      signal_crossfade_free(channel->soft_bypass);
+    }
+
+    if (channel->noise_profile_state) {
+      noise_profile_state_free(channel->noise_profile_state);
+    }
   }
+  free(self->channels);
 
-  if (self->lib_instance_1) {
-    specbleach_free(self->lib_instance_1);
+  if (self->restored_profile) {
+    profile_exchange_free(self->restored_profile);
   }
 
-  if (self->noise_profile_state_2) {
-    noise_profile_state_free(self->noise_profile_state_2);
-    free(self->noise_profile_2);
+  if (self->profile_library) {
+    profile_library_close(self->profile_library);
   }
 
-  if (self->lib_instance_2) {
-    specbleach_free(self->lib_instance_2);
+  if (self->retired_library) {
+    profile_library_close(self->retired_library);
   }
 
+  free(self->library_path);
+  free(self->store_profile);
+
   if (self->plugin_uri) {
     free(self->plugin_uri);
   }
 
-  if (self->soft_bypass) {
-    signal_crossfade_free(self->soft_bypass);
+  if (self->automation) {
+    control_automation_free(self->automation);
+  }
+
+  if (self->timing_trace) {
+    timing_trace_free(self->timing_trace);
+  }
+
+  if (self->reduction_meter) {
+    reduction_meter_free(self->reduction_meter);
+  }
+
+  if (self->noise_spectrum) {
+    spectrum_decimator_free(self->noise_spectrum);
   }
 
+  free(self->scratch_input);
+  free(self->scratch_output);
+
   free(instance);
 }
 
+static void process_channel(NoiseRepellentPlugin *self,
+                            PluginChannel *channel,
+                            const uint32_t number_of_samples) {
+  if (self->parameters_changed) {
+    specbleach_load_parameters(channel->lib_instance, self->parameters);
+  }
+
+  if (self->reset_requested) {
+    specbleach_reset_noise_profile(channel->lib_instance);
+  }
+
+  specbleach_process(channel->lib_instance, number_of_samples,
+                     channel->input + self->span_offset,
+                     channel->output + self->span_offset);
+}
+
+// Latency-matched passthrough used while the engine is not running
+static void bypass_channel(NoiseRepellentPlugin *self, PluginChannel *channel,
+                           const uint32_t number_of_samples) {
+  if (self->reset_requested) {
+    specbleach_reset_noise_profile(channel->lib_instance);
+  }
+
+  signal_crossfade_bypass(channel->soft_bypass, number_of_samples,
+                          channel->input + self->span_offset,
+                          channel->output + self->span_offset);
+}
+
+// Refills the engine with the latest input so it fades back in cleanly
+static void warm_up_channel(NoiseRepellentPlugin *self,
+                            PluginChannel *channel) {
+  const uint32_t latency = signal_crossfade_get_latency(channel->soft_bypass);
+  if (latency == 0U) {
+    return;
+  }
+
+  signal_crossfade_get_dry_history(channel->soft_bypass, self->scratch_input);
+
+  specbleach_load_parameters(channel->lib_instance, self->parameters);
+  specbleach_process(channel->lib_instance, latency, self->scratch_input,
+                     self->scratch_output);
+}
+
+// The helper keeps its channels past a missed deadline until it is done, and
+// no engine is touched in the meantime
+static bool helper_busy(const NoiseRepellentPlugin *self) {
+  return self->parallel_worker && channel_worker_busy(self->parallel_worker);
+}
+
+// Loads a profile staged by restore() between two blocks
+static void load_restored_profile(NoiseRepellentPlugin *self) {
+  if (helper_busy(self) ||
+      !profile_exchange_acquire(self->restored_profile)) {
+    return;
+  }
+
+  const uint32_t averaged_blocks =
+      profile_exchange_get_averaged_blocks(self->restored_profile);
+
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    specbleach_load_noise_profile(
+        self->channels[c].lib_instance,
+        profile_exchange_get_profile(self->restored_profile, c),
+        self->profile_size, averaged_blocks);
+  }
+
+  profile_exchange_release(self->restored_profile);
+  self->noise_spectrum_changed = true;
+}
+
+// Also unmaps the library replaced by the previous refresh, which run() may
+// no longer be reading by the time a new refresh is scheduled
+static void open_library_work(LV2_Handle instance, WorkerJob *job) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+
+  if (self->retired_library) {
+    profile_library_close(self->retired_library);
+    self->retired_library = NULL;
+  }
+
+  job->data = profile_library_open(self->library_path);
+}
+
+static bool find_library_profile(NoiseRepellentPlugin *self,
+                                 const char *profile_name) {
+  uint32_t profile_size = 0U;
+  uint32_t averaged_blocks = 0U;
+  const float *profile = profile_library_find(
+      self->profile_library, profile_name, (uint32_t)self->sample_rate,
+      (self->profile_size - 1U) * 2U, &profile_size, &averaged_blocks);
+  if (!profile || profile_size != self->profile_size) {
+    return false;
+  }
+
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    specbleach_load_noise_profile(self->channels[c].lib_instance, profile,
+                                  profile_size, averaged_blocks);
+  }
+  self->noise_spectrum_changed = true;
+
+  return true;
+}
+
+// Swaps in the freshly mapped library and retries a pending selection
+static void open_library_complete(LV2_Handle instance, WorkerJob *job) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+
+  if (job->data) {
+    self->retired_library = self->profile_library;
+    self->profile_library = (ProfileLibrary *)job->data;
+  }
+
+  self->library_refresh_pending = false;
+  self->profile_store_pending = false;
+
+  if (self->requested_profile[0] != '\0') {
+    find_library_profile(self, self->requested_profile);
+    self->requested_profile[0] = '\0';
+  }
+}
+
+static void store_profile_work(LV2_Handle instance, WorkerJob *job) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+
+  if (!profile_library_store(
+          self->library_path, self->store_name, (uint32_t)self->sample_rate,
+          (self->profile_size - 1U) * 2U, self->store_profile,
+          self->profile_size, self->store_averaged_blocks)) {
+    lv2_log_error(&self->log, "Could not store profile <%s> in <%s>\n",
+                  self->store_name, self->library_path);
+  }
+
+  open_library_work(instance, job);
+}
+
+static const char *atom_string(const NoiseRepellentPlugin *self,
+                               const LV2_Atom *atom) {
+  if (!atom || atom->type != self->uris.atom_String || atom->size == 0U ||
+      atom->size > PROFILE_LIBRARY_NAME_SIZE) {
+    return NULL;
+  }
+
+  const char *string = (const char *)LV2_ATOM_BODY_CONST(atom);
+  return string[atom->size - 1U] == '\0' ? string : NULL;
+}
+
+// Recalls a profile from the mapped library, no file is touched here. Names
+// missing from the mapping make the worker map the library again
+static void select_library_profile(NoiseRepellentPlugin *self,
+                                   const LV2_Atom *name) {
+  const char *profile_name = atom_string(self, name);
+  if (!profile_name || find_library_profile(self, profile_name) ||
+      !self->library_path) {
+    return;
+  }
+
+  if (!self->library_refresh_pending) {
+    if (!worker_job_schedule(self->schedule, open_library_work,
+                             open_library_complete, NULL)) {
+      return;
+    }
+    self->library_refresh_pending = true;
+  }
+
+  strcpy(self->requested_profile, profile_name);
+}
+
+// Snapshots the current profile and lets the worker write it to the library
+static void store_library_profile(NoiseRepellentPlugin *self,
+                                  const LV2_Atom *name) {
+  const char *profile_name = atom_string(self, name);
+  if (!profile_name || !self->library_path || self->profile_store_pending ||
+      self->library_refresh_pending ||
+      !specbleach_noise_profile_available(self->channels[0].lib_instance)) {
+    return;
+  }
+
+  memcpy(self->store_profile,
+         specbleach_get_noise_profile(self->channels[0].lib_instance),
+         sizeof(float) * self->profile_size);
+  self->store_averaged_blocks =
+      specbleach_get_noise_profile_blocks_averaged(
+          self->channels[0].lib_instance);
+  strcpy(self->store_name, profile_name);
+
+  if (worker_job_schedule(self->schedule, store_profile_work,
+                          open_library_complete, NULL)) {
+    self->profile_store_pending = true;
+    self->library_refresh_pending = true;
+  }
+}
+
+static bool atom_number(const NoiseRepellentPlugin *self,
+                        const LV2_Atom *atom, float *number) {
+  if (!atom) {
+    return false;
+  }
+
+  if (atom->type == self->uris.atom_Float) {
+    *number = ((const LV2_Atom_Float *)atom)->body;
+  } else if (atom->type == self->uris.atom_Int) {
+    *number = (float)((const LV2_Atom_Int *)atom)->body;
+  } else if (atom->type == self->uris.atom_Bool) {
+    *number = ((const LV2_Atom_Bool *)atom)->body ? 1.F : 0.F;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+static void process_control_event(NoiseRepellentPlugin *self,
+                                  const LV2_Atom_Event *event) {
+  const LV2_Atom_Object *object = (const LV2_Atom_Object *)&event->body;
+  if (event->body.type != self->uris.atom_Object ||
+      object->body.otype != self->uris.patch_Set) {
+    return;
+  }
+
+  const LV2_Atom_URID *property = NULL;
+  const LV2_Atom *value = NULL;
+  // clang-format off
+  lv2_atom_object_get(object,
+                      self->uris.patch_property, &property,
+                      self->uris.patch_value, &value,
+                      0);
+  // clang-format on
+
+  if (!property || property->atom.type != self->uris.atom_URID) {
+    return;
+  }
+
+  if (property->body == self->uris.profile) {
+    select_library_profile(self, value);
+    return;
+  }
+  if (property->body == self->uris.store_profile) {
+    store_library_profile(self, value);
+    return;
+  }
+
+  float number = 0.F;
+  for (uint32_t k = 0U; k < NOISEREPELLENT_CONTROLS; k++) {
+    if (property->body == self->uris.controls[k] &&
+        atom_number(self, value, &number)) {
+      control_automation_set(self->automation, k, number);
+      return;
+    }
+  }
+}
+
+static float control_value(const NoiseRepellentPlugin *self,
+                           const PortIndex port) {
+  return control_automation_get(self->automation, (uint32_t)port);
+}
+
+static bool engine_bypassed(const NoiseRepellentPlugin *self) {
+  return !(bool)control_value(self, NOISEREPELLENT_ENABLE) &&
+         !self->parameters.learn_noise &&
+         signal_crossfade_is_bypassed(self->channels[0].soft_bypass);
+}
+
+static void process_channels(NoiseRepellentPlugin *self, const uint32_t first,
+                             const uint32_t last,
+                             const uint32_t number_of_samples) {
+  for (uint32_t c = first; c < last; c++) {
+    process_channel(self, &self->channels[c], number_of_samples);
+  }
+}
+
+static void process_parallel_channels(void *data,
+                                      const uint32_t number_of_samples) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)data;
+
+  for (uint32_t c = self->parallel_split; c < self->number_of_channels; c++) {
+    SpectralBleachHandle lib_instance = self->channels[c].lib_instance;
+    const uint32_t k = (c - self->parallel_split) * MAX_SPAN;
+
+    if (self->parallel_load_parameters) {
+      specbleach_load_parameters(lib_instance, self->parallel_parameters);
+    }
+    if (self->parallel_reset) {
+      specbleach_reset_noise_profile(lib_instance);
+    }
+    specbleach_process(lib_instance, number_of_samples,
+                       self->parallel_input + k, self->parallel_output + k);
+  }
+}
+
+// The helper only reads and writes copies of its channels, so a job left to
+// it at a missed deadline can finish after run() returned. Returns false then
+static bool process_in_parallel(NoiseRepellentPlugin *self,
+                                const uint32_t number_of_samples) {
+  const uint32_t split = self->parallel_split;
+
+  self->parallel_parameters = self->parameters;
+  self->parallel_load_parameters = self->parameters_changed;
+  self->parallel_reset = self->reset_requested;
+  for (uint32_t c = split; c < self->number_of_channels; c++) {
+    memcpy(self->parallel_input + (c - split) * MAX_SPAN,
+           self->channels[c].input + self->span_offset,
+           sizeof(float) * number_of_samples);
+  }
+
+  channel_worker_dispatch(self->parallel_worker, number_of_samples);
+  process_channels(self, 0U, split, number_of_samples);
+  if (!channel_worker_join(self->parallel_worker)) {
+    return false;
+  }
+
+  for (uint32_t c = split; c < self->number_of_channels; c++) {
+    memcpy(self->channels[c].output + self->span_offset,
+           self->parallel_output + (c - split) * MAX_SPAN,
+           sizeof(float) * number_of_samples);
+  }
+  return true;
+}
+
+// Every channel passes the delayed dry signal without touching its engine,
+// and the engines are refilled once processing resumes
+static void output_dry(NoiseRepellentPlugin *self,
+                       const uint32_t number_of_samples) {
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    PluginChannel *channel = &self->channels[c];
+
+    signal_crossfade_bypass(channel->soft_bypass, number_of_samples,
+                            channel->input + self->span_offset,
+                            channel->output + self->span_offset);
+  }
+  self->engine_idle = true;
+}
+
+// Spawning the helper thread is left to the worker, so turning the port on
+// never blocks the audio thread
+static void start_parallel_work(LV2_Handle instance, WorkerJob *job) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+
+  ChannelWorker *worker = channel_worker_initialize(process_parallel_channels,
+                                                    self, self->sample_rate);
+  if (!worker) {
+    lv2_log_warning(&self->log, "Processing <%s> channels serially\n",
+                    self->plugin_uri);
+    return;
+  }
+  atomic_store_explicit(&self->started_worker, worker, memory_order_release);
+}
+
+static void start_parallel_complete(LV2_Handle instance, WorkerJob *job) {
+  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+
+  self->parallel_worker = atomic_exchange_explicit(
+      &self->started_worker, NULL, memory_order_acquire);
+}
+
+static bool parallel_enabled(NoiseRepellentPlugin *self) {
+  if (!self->parallel_channels || !(bool)*self->parallel_channels) {
+    return false;
+  }
+
+  if (!self->parallel_start_scheduled) {
+    self->parallel_start_scheduled = worker_job_schedule(
+        self->schedule, start_parallel_work, start_parallel_complete, NULL);
+  }
+
+  return self->parallel_worker != NULL;
+}
+
+static uint32_t channels_for(const char *uri) {
+  if (strcmp(uri, NOISEREPELLENT_STEREO_URI) == 0) {
+    return 2U;
+  }
+  if (strcmp(uri, NOISEREPELLENT_MULTICHANNEL_URI) == 0) {
+    return NOISEREPELLENT_MULTICHANNEL_CHANNELS;
+  }
+  return 1U;
+}
+
+static const char *state_prefix_for(const char *uri) {
+  if (strcmp(uri, NOISEREPELLENT_URI) == 0) {
+    return NOISEREPELLENT_STEREO_URI;
+  }
+  if (strcmp(uri, NOISEREPELLENT_STEREO_URI) == 0) {
+    return NOISEREPELLENT_URI;
+  }
+  return uri;
+}
+
 static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
                               const double rate, const char *bundle_path,
                               const LV2_Feature *const *features) {
   NoiseRepellentPlugin *self =
       (NoiseRepellentPlugin *)calloc(1U, sizeof(NoiseRepellentPlugin));
+  atomic_init(&self->started_worker, NULL);
 
   // clang-format off
   const char *missing =
       lv2_features_query(features,
                          LV2_LOG__log, &self->log.log, false,
                          LV2_URID__map, &self->map, true,
+                         LV2_WORKER__schedule, &self->schedule, false,
                          NULL);
   // clang-format on
 
@@ -188,174 +758,443 @@ static LV2_Handle instantiate(const LV2_Descriptor *descriptor,
     return NULL;
   }
 
-  if (strstr(descriptor->URI, NOISEREPELLENT_STEREO_URI)) {
-    self->plugin_uri =
-        (char *)calloc(strlen(NOISEREPELLENT_STEREO_URI) + 1U, sizeof(char));
-    strcpy(self->plugin_uri, descriptor->URI);
-  } else {
-    self->plugin_uri =
-        (char *)calloc(strlen(NOISEREPELLENT_URI) + 1U, sizeof(char));
-    strcpy(self->plugin_uri, descriptor->URI);
+  lv2_log_trace(&self->log, "Running %s kernels\n",
+                cpu_dispatch_level_name(cpu_dispatch_level()));
+
+  self->plugin_uri =
+      (char *)calloc(strlen(descriptor->URI) + 1U, sizeof(char));
+  strcpy(self->plugin_uri, descriptor->URI);
+
+  self->automation = control_automation_initialize(NOISEREPELLENT_CONTROLS);
+  if (!self->automation) {
+    cleanup((LV2_Handle)self);
+    return NULL;
   }
 
+  self->number_of_channels = channels_for(self->plugin_uri);
+  self->control_port = NOISEREPELLENT_INPUT_1 + 2U * self->number_of_channels;
+  self->reduction_average_port = self->control_port + 1U;
+  self->reduction_peak_port = self->control_port + 2U;
+  self->notify_port = self->control_port + 3U;
+  self->parallel_port =
+      self->number_of_channels > 1U ? self->control_port + 4U : UINT32_MAX;
+  // The helper thread takes the upper half of the channels
+  self->parallel_split = (self->number_of_channels + 1U) / 2U;
+
   map_uris(self->map, &self->uris, self->plugin_uri);
-  map_state(self->map, &self->state, self->plugin_uri);
+  lv2_atom_forge_init(&self->forge, self->map);
+  map_state(self->map, &self->state, state_prefix_for(self->plugin_uri),
+            self->number_of_channels);
 
   self->sample_rate = (float)rate;
 
-  self->soft_bypass = signal_crossfade_initialize((uint32_t)self->sample_rate);
-
-  if (!self->soft_bypass) {
+  self->channels = (PluginChannel *)calloc(self->number_of_channels,
+                                           sizeof(PluginChannel));
+  if (!self->channels) {
     cleanup((LV2_Handle)self);
     return NULL;
   }
 
-  self->lib_instance_1 = specbleach_initialize((uint32_t)self->sample_rate);
-  if (!self->lib_instance_1) {
-    lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
-    cleanup((LV2_Handle)self);
-    return NULL;
-  }
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    PluginChannel *channel = &self->channels[c];
 
-  self->profile_size = specbleach_get_noise_profile_size(self->lib_instance_1);
-  lv2_log_error(&self->log, "Profile Size <%u>\n",
-                (unsigned int)self->profile_size);
-  self->noise_profile_state_1 =
-      noise_profile_state_initialize(self->uris.atom_Float);
+    channel->lib_instance = specbleach_initialize((uint32_t)self->sample_rate);
+    if (!channel->lib_instance) {
+      lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+      cleanup((LV2_Handle)self);
+      return NULL;
+    }
 
-  self->noise_profile_1 = (float *)calloc(self->profile_size, sizeof(float));
+    if (c == 0U) {
+      self->profile_size =
+          specbleach_get_noise_profile_size(channel->lib_instance);
+    }
 
-  if (strstr(self->plugin_uri, NOISEREPELLENT_STEREO_URI)) {
-    self->lib_instance_2 = specbleach_initialize((uint32_t)self->sample_rate);
+    channel->soft_bypass = signal_crossfade_initialize(
+        (uint32_t)self->sample_rate,
+        specbleach_get_latency(channel->lib_instance));
+    channel->noise_profile_state = noise_profile_state_initialize(
+        self->uris.atom_Float, self->profile_size);
+    if (!channel->soft_bypass || !channel->noise_profile_state) {
+      cleanup((LV2_Handle)self);
+      return NULL;
+    }
+  }
 
-    if (!self->lib_instance_2) {
-      lv2_log_error(&self->log, "Error initializing <%s>\n", self->plugin_uri);
+  const uint32_t latency =
+      specbleach_get_latency(self->channels[0].lib_instance);
+  self->scratch_input = (float *)calloc(latency + 1U, sizeof(float));
+  self->scratch_output = (float *)calloc(latency + 1U, sizeof(float));
+  self->restored_profile =
+      profile_exchange_initialize(self->profile_size, self->number_of_channels);
+  self->reduction_meter =
+      reduction_meter_initialize((uint32_t)self->sample_rate);
+  self->noise_spectrum =
+      spectrum_decimator_initialize(self->profile_size, SPECTRUM_BANDS);
+
+  if (!self->scratch_input || !self->scratch_output ||
+      !self->restored_profile || !self->reduction_meter ||
+      !self->noise_spectrum) {
+    cleanup((LV2_Handle)self);
+    return NULL;
+  }
+
+  if (self->parallel_port != UINT32_MAX) {
+    const uint32_t helper_channels =
+        self->number_of_channels - self->parallel_split;
+    self->parallel_input =
+        (float *)calloc(helper_channels * MAX_SPAN, sizeof(float));
+    self->parallel_output =
+        (float *)calloc(helper_channels * MAX_SPAN, sizeof(float));
+    if (!self->parallel_input || !self->parallel_output) {
       cleanup((LV2_Handle)self);
       return NULL;
     }
+  }
 
-    self->noise_profile_state_2 =
-        noise_profile_state_initialize(self->uris.atom_Float);
+  char library_path[4096];
+  if (profile_library_default_path(library_path, sizeof(library_path))) {
+    self->library_path =
+        (char *)calloc(strlen(library_path) + 1U, sizeof(char));
+    self->store_profile = (float *)calloc(self->profile_size, sizeof(float));
+    if (!self->library_path || !self->store_profile) {
+      cleanup((LV2_Handle)self);
+      return NULL;
+    }
 
-    self->noise_profile_2 = (float *)calloc(self->profile_size, sizeof(float));
+    strcpy(self->library_path, library_path);
+    self->profile_library = profile_library_open(self->library_path);
   }
 
+  self->timing_trace =
+      timing_trace_initialize(self->plugin_uri, (uint32_t)self->sample_rate);
+
   return (LV2_Handle)self;
 }
 
 static void connect_port(LV2_Handle instance, uint32_t port, void *data) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
-  switch ((PortIndex)port) {
-  case NOISEREPELLENT_AMOUNT:
-    self->reduction_amount = (float *)data;
-    break;
-  case NOISEREPELLENT_NOISE_OFFSET:
-    self->noise_rescale = (float *)data;
-    break;
-  case NOISEREPELLENT_SMOOTHING:
-    self->smoothing_factor = (float *)data;
-    break;
-  case NOISEREPELLENT_WHITENING:
-    self->whitening_factor = (float *)data;
-    break;
-  case NOISEREPELLENT_TRANSIENT_PROTECTION:
-    self->transient_protection = (float *)data;
-    break;
-  case NOISEREPELLENT_NOISE_LEARN:
-    self->learn_noise = (float *)data;
-    break;
-  case NOISEREPELLENT_RESET_NOISE_PROFILE:
-    self->reset_noise_profile = (float *)data;
-    break;
-  case NOISEREPELLENT_RESIDUAL_LISTEN:
-    self->residual_listen = (float *)data;
-    break;
-  case NOISEREPELLENT_ENABLE:
-    self->enable = (float *)data;
-    break;
-  case NOISEREPELLENT_LATENCY:
+  if (port < NOISEREPELLENT_CONTROLS) {
+    control_automation_connect(self->automation, port, (const float *)data);
+  } else if (port == NOISEREPELLENT_LATENCY) {
     self->report_latency = (float *)data;
-    break;
-  case NOISEREPELLENT_INPUT_1:
-    self->input_1 = (const float *)data;
-    break;
-  case NOISEREPELLENT_OUTPUT_1:
-    self->output_1 = (float *)data;
-    break;
-  default:
-    break;
+  } else if (port == self->control_port) {
+    self->control = (const LV2_Atom_Sequence *)data;
+  } else if (port == self->reduction_average_port) {
+    self->reduction_average = (float *)data;
+  } else if (port == self->reduction_peak_port) {
+    self->reduction_peak = (float *)data;
+  } else if (port == self->notify_port) {
+    self->notify = (LV2_Atom_Sequence *)data;
+  } else if (port == self->parallel_port) {
+    self->parallel_channels = (float *)data;
+  } else if (port >= NOISEREPELLENT_INPUT_1 &&
+             port < NOISEREPELLENT_INPUT_1 + 2U * self->number_of_channels) {
+    PluginChannel *channel =
+        &self->channels[(port - NOISEREPELLENT_INPUT_1) / 2U];
+
+    if ((port - NOISEREPELLENT_INPUT_1) % 2U == 0U) {
+      channel->input = (const float *)data;
+    } else {
+      channel->output = (float *)data;
+    }
   }
 }
 
-static void connect_port_stereo(LV2_Handle instance, uint32_t port,
-                                void *data) {
-  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
-
-  connect_port(instance, port, data);
-
-  switch ((PortIndex)port) {
-  case NOISEREPELLENT_INPUT_2:
-    self->input_2 = (const float *)data;
-    break;
-  case NOISEREPELLENT_OUTPUT_2:
-    self->output_2 = (float *)data;
-    break;
-  default:
-    break;
+// The latency port is an output, so it is written on every block and not
+// only when the host happens to read it after activate()
+static void publish_latency(NoiseRepellentPlugin *self) {
+  if (self->report_latency) {
+    *self->report_latency =
+        (float)specbleach_get_latency(self->channels[0].lib_instance);
   }
 }
 
 static void activate(LV2_Handle instance) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
-  *self->report_latency = (float)specbleach_get_latency(self->lib_instance_1);
+  publish_latency(self);
 }
 
-static void run(LV2_Handle instance, uint32_t number_of_samples) {
-  NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+static float smooth_parameter(const float current, const float target,
+                              const float coefficient) {
+  if (fabsf(target - current) < PARAMETER_SETTLE_THRESHOLD) {
+    return target;
+  }
+  return current + coefficient * (target - current);
+}
 
+static SpectralBleachParameters
+target_parameters(const NoiseRepellentPlugin *self) {
   // clang-format off
-  self->parameters = (SpectralBleachParameters){
-      .learn_noise = (bool)*self->learn_noise,
-      .residual_listen = (bool)*self->residual_listen,
-      .transient_protection = (bool)*self->transient_protection,
-      .reduction_amount = *self->reduction_amount,
-      .noise_rescale = *self->noise_rescale,
-      .smoothing_factor = *self->smoothing_factor,
-      .whitening_factor = *self->whitening_factor,
+  return (SpectralBleachParameters){
+      .learn_noise = (bool)control_value(self, NOISEREPELLENT_NOISE_LEARN),
+      .residual_listen =
+          (bool)control_value(self, NOISEREPELLENT_RESIDUAL_LISTEN),
+      .transient_protection =
+          (bool)control_value(self, NOISEREPELLENT_TRANSIENT_PROTECTION),
+      .reduction_amount = control_value(self, NOISEREPELLENT_AMOUNT),
+      .noise_rescale = control_value(self, NOISEREPELLENT_NOISE_OFFSET),
+      .smoothing_factor = control_value(self, NOISEREPELLENT_SMOOTHING),
+      .whitening_factor = control_value(self, NOISEREPELLENT_WHITENING),
   };
   // clang-format on
+}
+
+// Continuous parameters still on their way to the port values
+static bool parameters_gliding(const NoiseRepellentPlugin *self) {
+  const SpectralBleachParameters target = target_parameters(self);
+  const SpectralBleachParameters *current = &self->parameters;
+
+  return self->parameters_loaded &&
+         (target.reduction_amount != current->reduction_amount ||
+          target.noise_rescale != current->noise_rescale ||
+          target.smoothing_factor != current->smoothing_factor ||
+          target.whitening_factor != current->whitening_factor);
+}
+
+// Parameters only reach the engines when a port moved. Continuous ones glide
+// towards their target so automation does not zipper. Reset acts once per
+// rising edge, while learn captures for as long as its port is on
+static void update_parameters(NoiseRepellentPlugin *self,
+                              const uint32_t number_of_samples) {
+  const bool reset =
+      (bool)control_value(self, NOISEREPELLENT_RESET_NOISE_PROFILE);
+  self->reset_requested = reset && !self->was_reset;
+  self->was_reset = reset;
+
+  const SpectralBleachParameters target = target_parameters(self);
+  SpectralBleachParameters *current = &self->parameters;
+
+  if (!self->parameters_loaded) {
+    *current = target;
+    self->parameters_changed = true;
+    self->parameters_loaded = true;
+    return;
+  }
+
+  const bool toggles_changed =
+      target.learn_noise != current->learn_noise ||
+      target.residual_listen != current->residual_listen ||
+      target.transient_protection != current->transient_protection;
+  const bool values_changed =
+      target.reduction_amount != current->reduction_amount ||
+      target.noise_rescale != current->noise_rescale ||
+      target.smoothing_factor != current->smoothing_factor ||
+      target.whitening_factor != current->whitening_factor;
+
+  self->parameters_changed = toggles_changed || values_changed;
+  if (!self->parameters_changed) {
+    return;
+  }
+
+  current->learn_noise = target.learn_noise;
+  current->residual_listen = target.residual_listen;
+  current->transient_protection = target.transient_protection;
+
+  if (values_changed) {
+    const float coefficient =
+        1.F - expf(-(float)number_of_samples /
+                   (PARAMETER_SMOOTHING_MS * 0.001F * self->sample_rate));
+
+    current->reduction_amount = smooth_parameter(
+        current->reduction_amount, target.reduction_amount, coefficient);
+    current->noise_rescale = smooth_parameter(
+        current->noise_rescale, target.noise_rescale, coefficient);
+    current->smoothing_factor = smooth_parameter(
+        current->smoothing_factor, target.smoothing_factor, coefficient);
+    current->whitening_factor = smooth_parameter(
+        current->whitening_factor, target.whitening_factor, coefficient);
+  }
+}
+
+// Processes part of the block with the control values in effect at its start
+static void run_span(NoiseRepellentPlugin *self, const uint32_t offset,
+                     const uint32_t number_of_samples) {
+  self->span_offset = offset;
+  if (helper_busy(self)) {
+    output_dry(self, number_of_samples);
+    return;
+  }
+
+  update_parameters(self, number_of_samples);
+
+  if (self->parameters.learn_noise || self->reset_requested) {
+    self->noise_spectrum_changed = true;
+  }
+
+  if (engine_bypassed(self)) {
+    for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+      bypass_channel(self, &self->channels[c], number_of_samples);
+    }
+    timing_trace_lap(self->timing_trace, TIMING_SECTION_CROSSFADE);
+    self->engine_idle = true;
+    return;
+  }
+
+  if (self->engine_idle) {
+    for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+      warm_up_channel(self, &self->channels[c]);
+    }
+    self->engine_idle = false;
+  }
 
-  specbleach_load_parameters(self->lib_instance_1, self->parameters);
+  if (parallel_enabled(self)) {
+    // The upper half of the channels overlaps with the lower one
+    if (!process_in_parallel(self, number_of_samples)) {
+      output_dry(self, number_of_samples);
+      return;
+    }
+  } else {
+    process_channels(self, 0U, self->number_of_channels, number_of_samples);
+  }
+
+  timing_trace_lap(self->timing_trace, TIMING_SECTION_PROCESS);
+
+  // The input is read again after the engines wrote the output, which is why
+  // the bundles declare lv2:inPlaceBroken
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    PluginChannel *channel = &self->channels[c];
+
+    if (self->meter_due) {
+      float dry_energy = 0.F;
+      float wet_energy = 0.F;
+      signal_crossfade_measure(channel->soft_bypass, number_of_samples,
+                               channel->input + offset,
+                               channel->output + offset, &dry_energy,
+                               &wet_energy);
+      reduction_meter_add(self->reduction_meter, dry_energy, wet_energy);
+    }
 
-  if ((bool)*self->reset_noise_profile) {
-    specbleach_reset_noise_profile(self->lib_instance_1);
+    signal_crossfade_run(channel->soft_bypass, number_of_samples,
+                         channel->input + offset, channel->output + offset,
+                         (bool)control_value(self, NOISEREPELLENT_ENABLE));
   }
+  timing_trace_lap(self->timing_trace, TIMING_SECTION_CROSSFADE);
+}
 
-  specbleach_process(self->lib_instance_1, number_of_samples, self->input_1,
-                     self->output_1);
+// Spans longer than the helper's copies are processed in pieces, and while
+// parameters glide in pieces short enough that no single step is audible
+static void run_spans(NoiseRepellentPlugin *self, uint32_t offset,
+                      uint32_t number_of_samples) {
+  while (number_of_samples > 0U) {
+    const uint32_t limit =
+        parameters_gliding(self) ? PARAMETER_STEP_SAMPLES : MAX_SPAN;
+    const uint32_t span =
+        number_of_samples < limit ? number_of_samples : limit;
+    run_span(self, offset, span);
+    offset += span;
+    number_of_samples -= span;
+  }
+}
+
+// The noise profile bands are only folded again after the profile changed
+static void send_noise_spectrum(NoiseRepellentPlugin *self,
+                                const uint32_t frame) {
+  SpectralBleachHandle lib_instance = self->channels[0].lib_instance;
+  if (!specbleach_noise_profile_available(lib_instance)) {
+    return;
+  }
 
-  signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_1,
-                       self->output_1, (bool)*self->enable);
+  if (self->noise_spectrum_changed) {
+    spectrum_decimator_run(self->noise_spectrum,
+                           specbleach_get_noise_profile(lib_instance));
+    self->noise_spectrum_changed = false;
+  }
+
+  LV2_Atom_Forge_Frame object_frame;
+  lv2_atom_forge_frame_time(&self->forge, frame);
+  lv2_atom_forge_object(&self->forge, &object_frame, 0U,
+                        self->uris.spectrum);
+  lv2_atom_forge_key(&self->forge, self->uris.noise_spectrum);
+  lv2_atom_forge_vector(
+      &self->forge, sizeof(float), self->uris.atom_Float,
+      spectrum_decimator_get_number_of_bands(self->noise_spectrum),
+      spectrum_decimator_get_bands(self->noise_spectrum));
+  lv2_atom_forge_pop(&self->forge, &object_frame);
+}
+
+// Meters are refreshed at a bounded rate, the ports keep their last value in
+// between
+static void publish_meters(NoiseRepellentPlugin *self,
+                           const uint32_t number_of_samples) {
+  if (self->meter_due) {
+    reduction_meter_update(self->reduction_meter);
+
+    if (self->notify) {
+      send_noise_spectrum(self, number_of_samples - 1U);
+    }
+  }
+
+  if (self->reduction_average) {
+    *self->reduction_average =
+        reduction_meter_get_average(self->reduction_meter);
+  }
+  if (self->reduction_peak) {
+    *self->reduction_peak = reduction_meter_get_peak(self->reduction_meter);
+  }
 }
 
-static void run_stereo(LV2_Handle instance, uint32_t number_of_samples) {
+// Events split the block so automation lands on the sample it was written
+// for. The engines take any number of samples, so nothing is buffered here
+static void run(LV2_Handle instance, uint32_t number_of_samples) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
+  timing_trace_begin(self->timing_trace);
 
-  run(instance, number_of_samples);
+  publish_latency(self);
+  if (self->parallel_worker) {
+    channel_worker_begin_block(self->parallel_worker, number_of_samples);
+  }
+  load_restored_profile(self);
+  control_automation_read_ports(self->automation);
+  self->meter_due =
+      reduction_meter_start_block(self->reduction_meter, number_of_samples);
+
+  if (self->notify) {
+    lv2_atom_forge_set_buffer(&self->forge, (uint8_t *)self->notify,
+                              self->notify->atom.size);
+    lv2_atom_forge_sequence_head(&self->forge, &self->notify_frame, 0U);
+  }
 
-  specbleach_load_parameters(self->lib_instance_2, self->parameters);
+  DenormalGuard denormal_guard;
+  denormal_guard_enter(&denormal_guard);
+
+  uint32_t offset = 0U;
+  if (self->control) {
+    LV2_ATOM_SEQUENCE_FOREACH(self->control, event) {
+      const uint32_t frame = event->time.frames < number_of_samples
+                                 ? (uint32_t)event->time.frames
+                                 : number_of_samples;
+      if (frame > offset) {
+        run_spans(self, offset, frame - offset);
+        offset = frame;
+      }
+
+      process_control_event(self, event);
+    }
+  }
 
-  if ((bool)*self->reset_noise_profile) {
-    specbleach_reset_noise_profile(self->lib_instance_2);
+  if (offset < number_of_samples) {
+    run_spans(self, offset, number_of_samples - offset);
   }
 
-  specbleach_process(self->lib_instance_2, number_of_samples, self->input_2,
-                     self->output_2);
+  if (number_of_samples > 0U) {
+    publish_meters(self, number_of_samples);
+  }
+  denormal_guard_leave(&denormal_guard);
+  if (self->notify) {
+    lv2_atom_forge_pop(&self->forge, &self->notify_frame);
+  }
 
-  signal_crossfade_run(self->soft_bypass, number_of_samples, self->input_2,
-                       self->output_2, (bool)*self->enable);
+  timing_trace_commit(self->timing_trace, number_of_samples);
+}
+
+static void store_uint(LV2_State_Store_Function store, LV2_State_Handle handle,
+                       const LV2_URID key, const uint32_t *value,
+                       const LV2_URID atom_Int) {
+  store(handle, key, value, sizeof(uint32_t), atom_Int,
+        LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
 }
 
 static LV2_State_Status save(LV2_Handle instance,
@@ -363,40 +1202,86 @@ static LV2_State_Status save(LV2_Handle instance,
                              LV2_State_Handle handle, uint32_t flags,
                              const LV2_Feature *const *features) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
-  if (!specbleach_noise_profile_available(self->lib_instance_1)) {
+
+  // A profile restored since the last block is the one the host expects back
+  const bool staged = profile_exchange_pending(self->restored_profile);
+  if (!staged &&
+      !specbleach_noise_profile_available(self->channels[0].lib_instance)) {
     return LV2_STATE_SUCCESS;
   }
 
-  store(handle, self->state.property_noise_profile_size, &self->profile_size,
-        sizeof(uint32_t), self->uris.atom_Int,
-        LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+  const uint32_t version = NOISE_PROFILE_STATE_VERSION;
+  const uint32_t sample_rate = (uint32_t)self->sample_rate;
+  const uint32_t fft_size = (self->profile_size - 1U) * 2U;
+  const uint32_t noise_profile_averaged_blocks =
+      staged ? profile_exchange_get_averaged_blocks(self->restored_profile)
+             : specbleach_get_noise_profile_blocks_averaged(
+                   self->channels[0].lib_instance);
+
+  store_uint(store, handle, self->state.property_version, &version,
+             self->uris.atom_Int);
+  store_uint(store, handle, self->state.property_noise_profile_size,
+             &self->profile_size, self->uris.atom_Int);
+  store_uint(store, handle, self->state.property_sample_rate, &sample_rate,
+             self->uris.atom_Int);
+  store_uint(store, handle, self->state.property_fft_size, &fft_size,
+             self->uris.atom_Int);
+  store_uint(store, handle, self->state.property_averaged_blocks,
+             &noise_profile_averaged_blocks, self->uris.atom_Int);
+
+  for (uint32_t c = 0U; c < self->number_of_channels; c++) {
+    const PluginChannel *channel = &self->channels[c];
+
+    const float *noise_profile =
+        staged ? profile_exchange_get_profile(self->restored_profile, c)
+               : specbleach_get_noise_profile(channel->lib_instance);
+
+    memcpy(noise_profile_get_elements(channel->noise_profile_state),
+           noise_profile, sizeof(float) * self->profile_size);
+
+    store(handle, self->state.property_noise_profiles[c],
+          noise_profile_get_body(channel->noise_profile_state),
+          noise_profile_get_size(channel->noise_profile_state),
+          self->uris.atom_Vector, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+  }
 
-  uint32_t noise_profile_averaged_blocks =
-      specbleach_get_noise_profile_blocks_averaged(self->lib_instance_1);
+  return LV2_STATE_SUCCESS;
+}
 
-  store(handle, self->state.property_averaged_blocks,
-        &noise_profile_averaged_blocks, sizeof(uint32_t), self->uris.atom_Int,
-        LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+static const uint32_t *retrieve_uint(LV2_State_Retrieve_Function retrieve,
+                                     LV2_State_Handle handle,
+                                     const LV2_URID key,
+                                     const LV2_URID atom_Int) {
+  size_t size = 0U;
+  uint32_t type = 0U;
+  uint32_t valflags = 0U;
 
-  memcpy(noise_profile_get_elements(self->noise_profile_state_1),
-         specbleach_get_noise_profile(self->lib_instance_1),
-         sizeof(float) * self->profile_size);
+  const uint32_t *value =
+      (const uint32_t *)retrieve(handle, key, &size, &type, &valflags);
+  if (!value || type != atom_Int || size != sizeof(uint32_t)) {
+    return NULL;
+  }
 
-  store(handle, self->state.property_noise_profile_1,
-        (void *)self->noise_profile_state_1, noise_profile_get_size(),
-        self->uris.atom_Vector, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+  return value;
+}
 
-  if (strstr(self->plugin_uri, NOISEREPELLENT_STEREO_URI)) {
-    memcpy(noise_profile_get_elements(self->noise_profile_state_2),
-           specbleach_get_noise_profile(self->lib_instance_2),
-           sizeof(float) * self->profile_size);
+static const float *retrieve_noise_profile(NoiseRepellentPlugin *self,
+                                           LV2_State_Retrieve_Function retrieve,
+                                           LV2_State_Handle handle,
+                                           const LV2_URID key) {
+  size_t size = 0U;
+  uint32_t type = 0U;
+  uint32_t valflags = 0U;
 
-    store(handle, self->state.property_noise_profile_2,
-          (void *)self->noise_profile_state_2, noise_profile_get_size(),
-          self->uris.atom_Vector, LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE);
+  const void *saved_noise_profile =
+      retrieve(handle, key, &size, &type, &valflags);
+  if (!saved_noise_profile || type != self->uris.atom_Vector) {
+    return NULL;
   }
 
-  return LV2_STATE_SUCCESS;
+  // Accepts both the exact size layout and the older fixed size one
+  return noise_profile_state_parse(saved_noise_profile, size,
+                                   self->profile_size);
 }
 
 static LV2_State_Status restore(LV2_Handle instance,
@@ -405,58 +1290,80 @@ static LV2_State_Status restore(LV2_Handle instance,
                                 const LV2_Feature *const *features) {
   NoiseRepellentPlugin *self = (NoiseRepellentPlugin *)instance;
 
-  size_t size = 0U;
-  uint32_t type = 0U;
-  uint32_t valflags = 0U;
-
-  const uint32_t *fftsize = (const uint32_t *)retrieve(
-      handle, self->state.property_noise_profile_size, &size, &type, &valflags);
-  if (fftsize == NULL || type != self->uris.atom_Int) {
-    return LV2_STATE_ERR_NO_PROPERTY;
+  // States from before versioning carry none of these, any other version or
+  // frame size is a layout this build does not know
+  const uint32_t *version = retrieve_uint(
+      retrieve, handle, self->state.property_version, self->uris.atom_Int);
+  if (version && *version != NOISE_PROFILE_STATE_VERSION) {
+    lv2_log_warning(&self->log, "Unknown noise profile state version %u\n",
+                    (unsigned int)*version);
+    return LV2_STATE_ERR_BAD_TYPE;
   }
 
-  const uint32_t *averagedblocks = (const uint32_t *)retrieve(
-      handle, self->state.property_averaged_blocks, &size, &type, &valflags);
-  if (averagedblocks == NULL || type != self->uris.atom_Int) {
-    return LV2_STATE_ERR_NO_PROPERTY;
+  const uint32_t *fft_size = retrieve_uint(
+      retrieve, handle, self->state.property_fft_size, self->uris.atom_Int);
+  if (fft_size && *fft_size != (self->profile_size - 1U) * 2U) {
+    lv2_log_warning(&self->log, "Noise profile frames of %u samples\n",
+                    (unsigned int)*fft_size);
+    return LV2_STATE_ERR_BAD_TYPE;
   }
 
-  const void *saved_noise_profile_1 = retrieve(
-      handle, self->state.property_noise_profile_1, &size, &type, &valflags);
-  if (!saved_noise_profile_1 || size != noise_profile_get_size() ||
-      type != self->uris.atom_Vector) {
+  const uint32_t *profile_size =
+      retrieve_uint(retrieve, handle, self->state.property_noise_profile_size,
+                    self->uris.atom_Int);
+  const uint32_t *averaged_blocks =
+      retrieve_uint(retrieve, handle, self->state.property_averaged_blocks,
+                    self->uris.atom_Int);
+  if (!profile_size || !averaged_blocks ||
+      *profile_size != self->profile_size) {
     return LV2_STATE_ERR_NO_PROPERTY;
   }
 
-  memcpy(self->noise_profile_1, (float *)LV2_ATOM_BODY(saved_noise_profile_1),
-         sizeof(float) * self->profile_size);
+  const uint32_t *sample_rate =
+      retrieve_uint(retrieve, handle, self->state.property_sample_rate,
+                    self->uris.atom_Int);
+  if (sample_rate && *sample_rate != (uint32_t)self->sample_rate) {
+    lv2_log_warning(&self->log, "Noise profile was learned at %u Hz\n",
+                    (unsigned int)*sample_rate);
+    return LV2_STATE_ERR_BAD_TYPE;
+  }
 
-  specbleach_load_noise_profile(self->lib_instance_1, self->noise_profile_1,
-                                *fftsize, *averagedblocks);
+  const float *saved_noise_profiles[MAX_CHANNELS] = {NULL};
 
-  if (strstr(self->plugin_uri, NOISEREPELLENT_STEREO_URI)) {
-    const void *saved_noise_profile_2 = retrieve(
-        handle, self->state.property_noise_profile_2, &size, &type, &valflags);
-    if (!saved_noise_profile_2 || size != noise_profile_get_size() ||
-        type != self->uris.atom_Vector) {
-      return LV2_STATE_ERR_NO_PROPERTY;
-    }
+  saved_noise_profiles[0] = retrieve_noise_profile(
+      self, retrieve, handle, self->state.property_noise_profiles[0]);
+  if (!saved_noise_profiles[0]) {
+    return LV2_STATE_ERR_NO_PROPERTY;
+  }
 
-    memcpy(self->noise_profile_2, (float *)LV2_ATOM_BODY(saved_noise_profile_2),
-           sizeof(float) * self->profile_size);
+  for (uint32_t c = 1U; c < self->number_of_channels; c++) {
+    saved_noise_profiles[c] = retrieve_noise_profile(
+        self, retrieve, handle, self->state.property_noise_profiles[c]);
 
-    specbleach_load_noise_profile(self->lib_instance_2, self->noise_profile_2,
-                                  *fftsize, *averagedblocks);
+    if (!saved_noise_profiles[c]) {
+      // Saved by a variant with fewer channels
+      saved_noise_profiles[c] = saved_noise_profiles[0];
+    }
   }
 
+  // The engines may be running, run() swaps the profile in between blocks
+  profile_exchange_publish(self->restored_profile, saved_noise_profiles,
+                           *averaged_blocks);
+
   return LV2_STATE_SUCCESS;
 }
 
 static const void *extension_data(const char *uri) {
+  static const LV2_Worker_Interface worker = {worker_job_work,
+                                              worker_job_work_response, NULL};
+
   static const LV2_State_Interface state = {save, restore};
   if (strcmp(uri, LV2_STATE__interface) == 0) {
     return &state;
   }
+  if (strcmp(uri, LV2_WORKER__interface) == 0) {
+    return &worker;
+  }
   return NULL;
 }
 
@@ -475,9 +1382,20 @@ static const LV2_Descriptor descriptor = {
 static const LV2_Descriptor descriptor_stereo = {
     NOISEREPELLENT_STEREO_URI,
     instantiate,
-    connect_port_stereo,
+    connect_port,
     activate,
-    run_stereo,
+    run,
+    NULL,
+    cleanup,
+    extension_data
+};
+
+static const LV2_Descriptor descriptor_multichannel = {
+    NOISEREPELLENT_MULTICHANNEL_URI,
+    instantiate,
+    connect_port,
+    activate,
+    run,
     NULL,
     cleanup,
     extension_data
@@ -490,6 +1408,8 @@ LV2_SYMBOL_EXPORT const LV2_Descriptor *lv2_descriptor(uint32_t index) {
     return &descriptor;
   case 1:
     return &descriptor_stereo;
+  case 2:
+    return &descriptor_multichannel;
   default:
     return NULL;
   }
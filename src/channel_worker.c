@@ -0,0 +1,278 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "channel_worker.h"
+#include "denormal_guard.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CPU_RELAX() _mm_pause()
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define CPU_RELAX() __asm__ __volatile__("yield")
+#else
+#define CPU_RELAX()
+#endif
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+// Share of the block duration after which the audio thread stops waiting
+// for the helper, spins between two looks at the clock and before yielding,
+// and how many blocks it then processes inline on its own
+#define JOIN_DEADLINE_SHARE 0.75
+#define JOIN_CLOCK_INTERVAL 64U
+#define JOIN_SPIN_LIMIT 4096U
+#define INLINE_FALLBACK_BLOCKS 64U
+
+typedef enum JobState {
+  JOB_IDLE = 0,
+  JOB_PENDING = 1,
+  JOB_RUNNING = 2,
+  JOB_DONE = 3,
+} JobState;
+
+struct ChannelWorker {
+  ChannelWorkerJob job;
+  void *data;
+  pthread_t thread;
+  bool thread_started;
+
+  atomic_int state;
+  atomic_bool quit;
+  atomic_int priority; // Realtime priority of the audio thread, -1 if none
+  uint32_t number_of_samples;
+  double sample_rate;
+  double deadline; // Monotonic seconds, set at the start of each block
+  uint32_t inline_blocks; // Blocks left to run inline after a slow join
+  bool priority_checked;
+
+#if defined(__APPLE__)
+  dispatch_semaphore_t wake;
+#else
+  sem_t wake;
+  bool wake_initialized;
+#endif
+};
+
+static void wake_helper(ChannelWorker *self) {
+#if defined(__APPLE__)
+  dispatch_semaphore_signal(self->wake);
+#else
+  sem_post(&self->wake);
+#endif
+}
+
+static void wait_for_work(ChannelWorker *self) {
+#if defined(__APPLE__)
+  dispatch_semaphore_wait(self->wake, DISPATCH_TIME_FOREVER);
+#else
+  while (sem_wait(&self->wake) != 0) {
+  }
+#endif
+}
+
+static double now_seconds(void) {
+  struct timespec time_now;
+  clock_gettime(CLOCK_MONOTONIC, &time_now);
+  return (double)time_now.tv_sec + (double)time_now.tv_nsec * 1e-9;
+}
+
+static bool run_if_pending(ChannelWorker *self) {
+  int expected = JOB_PENDING;
+  if (!atomic_compare_exchange_strong_explicit(&self->state, &expected,
+                                               JOB_RUNNING,
+                                               memory_order_acquire,
+                                               memory_order_relaxed)) {
+    return false;
+  }
+
+  self->job(self->data, self->number_of_samples);
+  return true;
+}
+
+static void *helper_thread(void *data) {
+  ChannelWorker *self = (ChannelWorker *)data;
+  int applied_priority = -1;
+
+  // This thread only ever runs plugin jobs, so it flushes for its lifetime
+  DenormalGuard denormal_guard;
+  denormal_guard_enter(&denormal_guard);
+
+  for (;;) {
+    wait_for_work(self);
+
+    if (atomic_load_explicit(&self->quit, memory_order_acquire)) {
+      break;
+    }
+
+    // Follow the scheduling class of the audio thread once it is known
+    const int priority =
+        atomic_load_explicit(&self->priority, memory_order_relaxed);
+    if (priority >= 0 && priority != applied_priority) {
+      struct sched_param param;
+      memset(&param, 0, sizeof(param));
+      param.sched_priority = priority;
+      pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+      applied_priority = priority;
+    }
+
+    if (run_if_pending(self)) {
+      atomic_store_explicit(&self->state, JOB_DONE, memory_order_release);
+    }
+  }
+
+  return NULL;
+}
+
+ChannelWorker *channel_worker_initialize(ChannelWorkerJob job, void *data,
+                                         const float sample_rate) {
+  ChannelWorker *self = (ChannelWorker *)calloc(1U, sizeof(ChannelWorker));
+  if (!self) {
+    return NULL;
+  }
+
+  self->job = job;
+  self->data = data;
+  self->sample_rate = (double)sample_rate;
+  atomic_init(&self->state, JOB_IDLE);
+  atomic_init(&self->quit, false);
+  atomic_init(&self->priority, -1);
+
+#if defined(__APPLE__)
+  self->wake = dispatch_semaphore_create(0);
+  if (!self->wake) {
+    channel_worker_free(self);
+    return NULL;
+  }
+#else
+  if (sem_init(&self->wake, 0, 0U) != 0) {
+    channel_worker_free(self);
+    return NULL;
+  }
+  self->wake_initialized = true;
+#endif
+
+  if (pthread_create(&self->thread, NULL, helper_thread, self) != 0) {
+    channel_worker_free(self);
+    return NULL;
+  }
+  self->thread_started = true;
+
+  return self;
+}
+
+void channel_worker_free(ChannelWorker *self) {
+  if (self->thread_started) {
+    atomic_store_explicit(&self->quit, true, memory_order_release);
+    wake_helper(self);
+    pthread_join(self->thread, NULL);
+  }
+
+#if defined(__APPLE__)
+  if (self->wake) {
+    dispatch_release(self->wake);
+  }
+#else
+  if (self->wake_initialized) {
+    sem_destroy(&self->wake);
+  }
+#endif
+
+  free(self);
+}
+
+void channel_worker_dispatch(ChannelWorker *self,
+                             const uint32_t number_of_samples) {
+  if (!self->priority_checked) {
+    int policy = 0;
+    struct sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) == 0 &&
+        (policy == SCHED_FIFO || policy == SCHED_RR)) {
+      atomic_store_explicit(&self->priority, param.sched_priority,
+                            memory_order_relaxed);
+    }
+    self->priority_checked = true;
+  }
+
+  self->number_of_samples = number_of_samples;
+  atomic_store_explicit(&self->state, JOB_PENDING, memory_order_release);
+
+  // Left pending, the job is picked up inline by the join
+  if (self->inline_blocks > 0U) {
+    self->inline_blocks--;
+    return;
+  }
+  wake_helper(self);
+}
+
+void channel_worker_begin_block(ChannelWorker *self,
+                                const uint32_t number_of_samples) {
+  self->deadline = now_seconds() + JOIN_DEADLINE_SHARE *
+                                       (double)number_of_samples /
+                                       self->sample_rate;
+}
+
+// A job left to the helper at a missed deadline is still running
+bool channel_worker_busy(const ChannelWorker *self) {
+  return atomic_load_explicit(&self->state, memory_order_acquire) ==
+         JOB_RUNNING;
+}
+
+bool channel_worker_join(ChannelWorker *self) {
+  if (run_if_pending(self)) {
+    // The helper did not get to it in time, it was processed inline instead
+    atomic_store_explicit(&self->state, JOB_IDLE, memory_order_relaxed);
+    return true;
+  }
+
+  // The helper owns the channel until it is done. Past the spin bound the
+  // audio thread yields the core to it, and past the deadline it leaves the
+  // job to the helper and stops handing it the next blocks
+  uint32_t spins = 0U;
+  while (atomic_load_explicit(&self->state, memory_order_acquire) !=
+         JOB_DONE) {
+    if (spins % JOIN_CLOCK_INTERVAL == 0U && now_seconds() > self->deadline) {
+      self->inline_blocks = INLINE_FALLBACK_BLOCKS;
+      return false;
+    }
+
+    if (spins < JOIN_SPIN_LIMIT) {
+      CPU_RELAX();
+      spins++;
+    } else {
+      self->inline_blocks = INLINE_FALLBACK_BLOCKS;
+      sched_yield();
+    }
+  }
+
+  atomic_store_explicit(&self->state, JOB_IDLE, memory_order_relaxed);
+  return true;
+}
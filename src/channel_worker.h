@@ -0,0 +1,48 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef CHANNEL_WORKER_H
+#define CHANNEL_WORKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Realtime helper thread that processes one channel while the audio thread
+// processes another. A dispatched job is either claimed by the helper or, if
+// the helper has not started it by the time the audio thread joins, run
+// inline by the audio thread itself. Joining never waits past a deadline set
+// at the start of each block: a job the helper is still running then is left
+// to it, the join reports it as missed and the worker stays busy until the
+// helper is done. The next blocks are then run inline.
+
+typedef void (*ChannelWorkerJob)(void *data, uint32_t number_of_samples);
+
+typedef struct ChannelWorker ChannelWorker;
+
+ChannelWorker *channel_worker_initialize(ChannelWorkerJob job, void *data,
+                                         float sample_rate);
+void channel_worker_free(ChannelWorker *self);
+void channel_worker_begin_block(ChannelWorker *self,
+                                uint32_t number_of_samples);
+bool channel_worker_busy(const ChannelWorker *self);
+void channel_worker_dispatch(ChannelWorker *self, uint32_t number_of_samples);
+bool channel_worker_join(ChannelWorker *self);
+
+#endif
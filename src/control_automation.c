@@ -0,0 +1,96 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "control_automation.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+struct ControlAutomation {
+  const float **ports;
+  float *port_values; // Port values seen on the previous block
+  float *values;
+  uint32_t number_of_controls;
+  bool ports_read;
+};
+
+ControlAutomation *
+control_automation_initialize(const uint32_t number_of_controls) {
+  ControlAutomation *self =
+      (ControlAutomation *)calloc(1U, sizeof(ControlAutomation));
+  if (!self) {
+    return NULL;
+  }
+
+  self->number_of_controls = number_of_controls;
+  self->ports = (const float **)calloc(number_of_controls, sizeof(float *));
+  self->port_values = (float *)calloc(number_of_controls, sizeof(float));
+  self->values = (float *)calloc(number_of_controls, sizeof(float));
+
+  if (!self->ports || !self->port_values || !self->values) {
+    control_automation_free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void control_automation_free(ControlAutomation *self) {
+  free(self->ports);
+  free(self->port_values);
+  free(self->values);
+  free(self);
+}
+
+void control_automation_connect(ControlAutomation *self,
+                                const uint32_t control, const float *port) {
+  if (control < self->number_of_controls) {
+    self->ports[control] = port;
+  }
+}
+
+// A port only overrides the value when the host moved it, otherwise the last
+// event keeps applying across blocks
+void control_automation_read_ports(ControlAutomation *self) {
+  for (uint32_t k = 0U; k < self->number_of_controls; k++) {
+    if (!self->ports[k]) {
+      continue;
+    }
+
+    const float port_value = *self->ports[k];
+    if (!self->ports_read || port_value != self->port_values[k]) {
+      self->values[k] = port_value;
+      self->port_values[k] = port_value;
+    }
+  }
+
+  self->ports_read = true;
+}
+
+void control_automation_set(ControlAutomation *self, const uint32_t control,
+                            const float value) {
+  if (control < self->number_of_controls) {
+    self->values[control] = value;
+  }
+}
+
+float control_automation_get(const ControlAutomation *self,
+                             const uint32_t control) {
+  return self->values[control];
+}
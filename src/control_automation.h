@@ -0,0 +1,38 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef CONTROL_AUTOMATION_H
+#define CONTROL_AUTOMATION_H
+
+#include <stdint.h>
+
+// Effective values of the control inputs. Ports update them at the start of
+// a block when they move, timestamped events anywhere within the block
+typedef struct ControlAutomation ControlAutomation;
+
+ControlAutomation *control_automation_initialize(uint32_t number_of_controls);
+void control_automation_free(ControlAutomation *self);
+void control_automation_connect(ControlAutomation *self, uint32_t control,
+                                const float *port);
+void control_automation_read_ports(ControlAutomation *self);
+void control_automation_set(ControlAutomation *self, uint32_t control,
+                            float value);
+float control_automation_get(const ControlAutomation *self, uint32_t control);
+#endif
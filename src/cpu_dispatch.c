@@ -0,0 +1,61 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "cpu_dispatch.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CPU_LEVEL_ENV "NOISEREPELLENT_CPU_LEVEL"
+
+static const char *const level_names[] = {"baseline", "avx2"};
+
+static CpuLevel supported_level(void) {
+#if defined(NOISEREPELLENT_CPU_DISPATCH) &&                                    \
+    (defined(__x86_64__) || defined(__i386__)) &&                              \
+    (defined(__GNUC__) || defined(__clang__))
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return CPU_LEVEL_AVX2;
+  }
+#endif
+  return CPU_LEVEL_BASELINE;
+}
+
+CpuLevel cpu_dispatch_level(void) {
+  const CpuLevel supported = supported_level();
+
+  const char *requested = getenv(CPU_LEVEL_ENV);
+  if (!requested) {
+    return supported;
+  }
+
+  for (int level = CPU_LEVEL_BASELINE; level < (int)supported; level++) {
+    if (strcmp(requested, level_names[level]) == 0) {
+      return (CpuLevel)level;
+    }
+  }
+
+  return supported;
+}
+
+const char *cpu_dispatch_level_name(const CpuLevel level) {
+  return level_names[level];
+}
@@ -0,0 +1,37 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+// Instruction set level the DSP kernels run at. Builds with
+// NOISEREPELLENT_CPU_DISPATCH carry kernels for every level and pick the
+// best one the processor supports when a plugin is instantiated. The
+// NOISEREPELLENT_CPU_LEVEL environment variable can lower the choice.
+
+typedef enum CpuLevel {
+  CPU_LEVEL_BASELINE = 0,
+  CPU_LEVEL_AVX2 = 1,
+} CpuLevel;
+
+CpuLevel cpu_dispatch_level(void);
+const char *cpu_dispatch_level_name(CpuLevel level);
+
+#endif
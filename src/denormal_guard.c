@@ -0,0 +1,85 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "denormal_guard.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define DENORMAL_GUARD_SSE
+#define FLUSH_TO_ZERO 0x8000U     // MXCSR FTZ
+#define DENORMALS_ARE_ZERO 0x40U  // MXCSR DAZ
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+#define DENORMAL_GUARD_AARCH64
+#define FLUSH_TO_ZERO (1U << 24U) // FPCR FZ, covers inputs as well
+#elif defined(__arm__) && defined(__ARM_FP) &&                                 \
+    (defined(__GNUC__) || defined(__clang__))
+#define DENORMAL_GUARD_ARM
+#define FLUSH_TO_ZERO (1U << 24U) // FPSCR FZ, covers inputs as well
+#endif
+
+static uintptr_t read_state(void) {
+#if defined(DENORMAL_GUARD_SSE)
+  return (uintptr_t)_mm_getcsr();
+#elif defined(DENORMAL_GUARD_AARCH64)
+  uint64_t state = 0U;
+  __asm__ __volatile__("mrs %0, fpcr" : "=r"(state));
+  return (uintptr_t)state;
+#elif defined(DENORMAL_GUARD_ARM)
+  uint32_t state = 0U;
+  __asm__ __volatile__("vmrs %0, fpscr" : "=r"(state));
+  return (uintptr_t)state;
+#else
+  return 0U;
+#endif
+}
+
+static void write_state(const uintptr_t state) {
+#if defined(DENORMAL_GUARD_SSE)
+  _mm_setcsr((unsigned int)state);
+#elif defined(DENORMAL_GUARD_AARCH64)
+  __asm__ __volatile__("msr fpcr, %0" : : "r"((uint64_t)state));
+#elif defined(DENORMAL_GUARD_ARM)
+  __asm__ __volatile__("vmsr fpscr, %0" : : "r"((uint32_t)state));
+#else
+  (void)state;
+#endif
+}
+
+void denormal_guard_enter(DenormalGuard *self) {
+  self->saved_state = read_state();
+#if defined(DENORMAL_GUARD_SSE)
+  self->flushing_state = self->saved_state | FLUSH_TO_ZERO | DENORMALS_ARE_ZERO;
+#elif defined(DENORMAL_GUARD_AARCH64) || defined(DENORMAL_GUARD_ARM)
+  self->flushing_state = self->saved_state | FLUSH_TO_ZERO;
+#else
+  self->flushing_state = self->saved_state;
+#endif
+
+  // Most hosts already flush, writing the register is not free
+  if (self->flushing_state != self->saved_state) {
+    write_state(self->flushing_state);
+  }
+}
+
+void denormal_guard_leave(const DenormalGuard *self) {
+  if (self->flushing_state != self->saved_state) {
+    write_state(self->saved_state);
+  }
+}
@@ -0,0 +1,37 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef DENORMAL_GUARD_H
+#define DENORMAL_GUARD_H
+
+#include <stdint.h>
+
+// Flushes denormal results and operands to zero while the plugin processes,
+// so decaying tails inside the engines never hit the slow microcode paths.
+// The host's floating point control register is put back on leave.
+typedef struct DenormalGuard {
+  uintptr_t saved_state;
+  uintptr_t flushing_state;
+} DenormalGuard;
+
+void denormal_guard_enter(DenormalGuard *self);
+void denormal_guard_leave(const DenormalGuard *self);
+
+#endif
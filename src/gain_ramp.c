@@ -0,0 +1,246 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "gain_ramp.h"
+#include "cpu_dispatch.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define GAIN_RAMP_SSE
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define GAIN_RAMP_NEON
+#endif
+
+// Wider kernels compiled next to the baseline one, picked at runtime
+#if defined(NOISEREPELLENT_CPU_DISPATCH) && defined(GAIN_RAMP_SSE) &&        \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define GAIN_RAMP_DISPATCH
+#endif
+
+#define LANES 4U
+#define STRIDE (2U * LANES)
+#define MAX_STRIDE 16U // Two AVX2 vectors
+// Below this distance to the target the ramp is over and the gain is held
+#define SETTLE_DISTANCE 1e-6F
+
+typedef float (*MixRamp)(const GainRamp *self, uint32_t number_of_samples,
+                         const float *dry, const float *wet, float *output);
+
+struct GainRamp {
+  float target;
+  float distance; // Gain minus target, shrinks by decay every sample
+  float decay;
+  float decay_powers[MAX_STRIDE]; // decay^1 to decay^MAX_STRIDE
+  MixRamp mix_ramp;
+};
+
+static float mix_ramp(const GainRamp *self, uint32_t number_of_samples,
+                      const float *dry, const float *wet, float *output);
+#if defined(GAIN_RAMP_DISPATCH)
+static float mix_ramp_avx2(const GainRamp *self, uint32_t number_of_samples,
+                           const float *dry, const float *wet, float *output);
+#endif
+
+static MixRamp select_mix_ramp(void) {
+#if defined(GAIN_RAMP_DISPATCH)
+  switch (cpu_dispatch_level()) {
+  case CPU_LEVEL_AVX2:
+    return mix_ramp_avx2;
+  case CPU_LEVEL_BASELINE:
+    break;
+  }
+#endif
+  return mix_ramp;
+}
+
+GainRamp *gain_ramp_initialize(const float decay, const float initial_gain) {
+  GainRamp *self = (GainRamp *)calloc(1U, sizeof(GainRamp));
+  if (!self) {
+    return NULL;
+  }
+
+  self->decay = decay;
+  self->target = initial_gain;
+  self->distance = 0.F;
+
+  float power = 1.F;
+  for (uint32_t k = 0U; k < MAX_STRIDE; k++) {
+    power *= decay;
+    self->decay_powers[k] = power;
+  }
+  self->mix_ramp = select_mix_ramp();
+
+  return self;
+}
+
+void gain_ramp_free(GainRamp *self) { free(self); }
+
+void gain_ramp_set_target(GainRamp *self, const float target) {
+  self->distance += self->target - target;
+  self->target = target;
+}
+
+float gain_ramp_get_target(const GainRamp *self) { return self->target; }
+
+float gain_ramp_get_gain(const GainRamp *self) {
+  return self->target + self->distance;
+}
+
+// A settled gain of zero or one only has to pick one of the signals
+static bool copy_settled(const GainRamp *self, const uint32_t number_of_samples,
+                         const float *dry, const float *wet, float *output) {
+  if (self->target == 0.F) {
+    memmove(output, dry, sizeof(float) * number_of_samples);
+    return true;
+  }
+  if (self->target == 1.F) {
+    if (output != wet) {
+      memmove(output, wet, sizeof(float) * number_of_samples);
+    }
+    return true;
+  }
+  return false;
+}
+
+// Samples left over after the vector steps
+static float mix_ramp_tail(const GainRamp *self, uint32_t k,
+                           const uint32_t number_of_samples, const float *dry,
+                           const float *wet, float *output, float distance) {
+  for (; k < number_of_samples; k++) {
+    distance *= self->decay;
+    output[k] = dry[k] + (self->target + distance) * (wet[k] - dry[k]);
+  }
+
+  return distance;
+}
+
+#if defined(GAIN_RAMP_SSE)
+static inline __m128 mix_lanes(const __m128 dry, const __m128 wet,
+                               const __m128 gains) {
+  return _mm_add_ps(dry, _mm_mul_ps(gains, _mm_sub_ps(wet, dry)));
+}
+#elif defined(GAIN_RAMP_NEON)
+static inline float32x4_t mix_lanes(const float32x4_t dry,
+                                    const float32x4_t wet,
+                                    const float32x4_t gains) {
+  return vmlaq_f32(dry, gains, vsubq_f32(wet, dry));
+}
+#endif
+
+// Sample k of the ramp gets target + distance * decay^(k + 1). Two vectors
+// per step halve the chain of multiplications carried between iterations
+static float mix_ramp(const GainRamp *self, const uint32_t number_of_samples,
+                      const float *dry, const float *wet, float *output) {
+  const float target = self->target;
+  float distance = self->distance;
+  uint32_t k = 0U;
+
+#if defined(GAIN_RAMP_SSE)
+  const __m128 targets = _mm_set1_ps(target);
+  const __m128 low_powers = _mm_loadu_ps(&self->decay_powers[0]);
+  const __m128 high_powers = _mm_loadu_ps(&self->decay_powers[LANES]);
+  const float step = self->decay_powers[STRIDE - 1U];
+
+  for (; k + STRIDE <= number_of_samples; k += STRIDE) {
+    const __m128 distances = _mm_set1_ps(distance);
+    const __m128 low_gains =
+        _mm_add_ps(targets, _mm_mul_ps(distances, low_powers));
+    const __m128 high_gains =
+        _mm_add_ps(targets, _mm_mul_ps(distances, high_powers));
+
+    _mm_storeu_ps(&output[k], mix_lanes(_mm_loadu_ps(&dry[k]),
+                                        _mm_loadu_ps(&wet[k]), low_gains));
+    _mm_storeu_ps(&output[k + LANES],
+                  mix_lanes(_mm_loadu_ps(&dry[k + LANES]),
+                            _mm_loadu_ps(&wet[k + LANES]), high_gains));
+    distance *= step;
+  }
+#elif defined(GAIN_RAMP_NEON)
+  const float32x4_t targets = vdupq_n_f32(target);
+  const float32x4_t low_powers = vld1q_f32(&self->decay_powers[0]);
+  const float32x4_t high_powers = vld1q_f32(&self->decay_powers[LANES]);
+  const float step = self->decay_powers[STRIDE - 1U];
+
+  for (; k + STRIDE <= number_of_samples; k += STRIDE) {
+    const float32x4_t low_gains = vmlaq_n_f32(targets, low_powers, distance);
+    const float32x4_t high_gains = vmlaq_n_f32(targets, high_powers, distance);
+
+    vst1q_f32(&output[k],
+              mix_lanes(vld1q_f32(&dry[k]), vld1q_f32(&wet[k]), low_gains));
+    vst1q_f32(&output[k + LANES],
+              mix_lanes(vld1q_f32(&dry[k + LANES]),
+                        vld1q_f32(&wet[k + LANES]), high_gains));
+    distance *= step;
+  }
+#endif
+
+  return mix_ramp_tail(self, k, number_of_samples, dry, wet, output, distance);
+}
+
+#if defined(GAIN_RAMP_DISPATCH)
+__attribute__((target("avx2,fma"))) static float
+mix_ramp_avx2(const GainRamp *self, const uint32_t number_of_samples,
+              const float *dry, const float *wet, float *output) {
+  const uint32_t lanes = 8U;
+  const __m256 targets = _mm256_set1_ps(self->target);
+  const __m256 low_powers = _mm256_loadu_ps(&self->decay_powers[0]);
+  const __m256 high_powers = _mm256_loadu_ps(&self->decay_powers[lanes]);
+  const float step = self->decay_powers[2U * lanes - 1U];
+  float distance = self->distance;
+  uint32_t k = 0U;
+
+  for (; k + 2U * lanes <= number_of_samples; k += 2U * lanes) {
+    const __m256 distances = _mm256_set1_ps(distance);
+
+    for (uint32_t half = 0U; half < 2U; half++) {
+      const uint32_t i = k + half * lanes;
+      const __m256 gains = _mm256_fmadd_ps(
+          distances, half == 0U ? low_powers : high_powers, targets);
+      const __m256 dry_lanes = _mm256_loadu_ps(&dry[i]);
+      const __m256 difference =
+          _mm256_sub_ps(_mm256_loadu_ps(&wet[i]), dry_lanes);
+      _mm256_storeu_ps(&output[i],
+                       _mm256_fmadd_ps(gains, difference, dry_lanes));
+    }
+    distance *= step;
+  }
+
+  return mix_ramp_tail(self, k, number_of_samples, dry, wet, output, distance);
+}
+#endif
+
+// output = dry + gain * (wet - dry). The output may be the wet buffer
+void gain_ramp_mix(GainRamp *self, const uint32_t number_of_samples,
+                   const float *dry, const float *wet, float *output) {
+  if (fabsf(self->distance) < SETTLE_DISTANCE) {
+    // A settled ramp goes through the same kernel with a constant gain
+    self->distance = 0.F;
+    if (copy_settled(self, number_of_samples, dry, wet, output)) {
+      return;
+    }
+  }
+
+  self->distance = self->mix_ramp(self, number_of_samples, dry, wet, output);
+}
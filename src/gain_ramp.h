@@ -0,0 +1,42 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef GAIN_RAMP_H
+#define GAIN_RAMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Mixes two signals with a gain that moves towards its target by a constant
+// factor every sample, so a fade sounds the same at any block size. The mix
+// runs eight samples at a time, as two vectors of four, on SSE and NEON and
+// falls back to plain C elsewhere.
+
+typedef struct GainRamp GainRamp;
+
+GainRamp *gain_ramp_initialize(float decay, float initial_gain);
+void gain_ramp_free(GainRamp *self);
+void gain_ramp_set_target(GainRamp *self, float target);
+float gain_ramp_get_target(const GainRamp *self);
+float gain_ramp_get_gain(const GainRamp *self);
+void gain_ramp_mix(GainRamp *self, uint32_t number_of_samples,
+                   const float *dry, const float *wet, float *output);
+
+#endif
@@ -20,26 +20,75 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 #include "noise_profile_state.h"
 
-#define MAX_PROFILE_SIZE 8192
+// Fixed capacity used by sessions saved before profiles were stored at their
+// exact size
+#define LEGACY_PROFILE_SIZE 8192U
 
-struct NoiseProfileState {
+typedef struct VectorBody {
   uint32_t child_size;
   uint32_t child_type;
-  float elements[MAX_PROFILE_SIZE];
-}; // LV2 Atoms Vector Specification
+} VectorBody; // LV2 Atoms Vector Specification
+
+struct NoiseProfileState {
+  uint32_t profile_size;
+  VectorBody *body;
+};
 
-NoiseProfileState *noise_profile_state_initialize(LV2_URID child_type) {
+NoiseProfileState *noise_profile_state_initialize(LV2_URID child_type,
+                                                  const uint32_t profile_size) {
   NoiseProfileState *self =
       (NoiseProfileState *)calloc(1U, sizeof(NoiseProfileState));
-  self->child_type = (uint32_t)child_type;
-  self->child_size = (uint32_t)sizeof(float);
+  if (!self) {
+    return NULL;
+  }
+
+  self->profile_size = profile_size;
+  self->body = (VectorBody *)calloc(
+      1U, sizeof(VectorBody) + sizeof(float) * (size_t)profile_size);
+  if (!self->body) {
+    free(self);
+    return NULL;
+  }
+
+  self->body->child_type = (uint32_t)child_type;
+  self->body->child_size = (uint32_t)sizeof(float);
 
   return self;
 }
 
-void noise_profile_state_free(NoiseProfileState *self) { free(self); }
+void noise_profile_state_free(NoiseProfileState *self) {
+  free(self->body);
+  free(self);
+}
 
 float *noise_profile_get_elements(NoiseProfileState *self) {
-  return self->elements;
+  return (float *)(self->body + 1);
+}
+
+const void *noise_profile_get_body(const NoiseProfileState *self) {
+  return self->body;
+}
+
+size_t noise_profile_get_size(const NoiseProfileState *self) {
+  return sizeof(VectorBody) + sizeof(float) * (size_t)self->profile_size;
 }
-size_t noise_profile_get_size() { return sizeof(NoiseProfileState); }
\ No newline at end of file
+
+const float *noise_profile_state_parse(const void *body, const size_t size,
+                                       const uint32_t profile_size) {
+  if (!body || size < sizeof(VectorBody)) {
+    return NULL;
+  }
+
+  const VectorBody *header = (const VectorBody *)body;
+  if (header->child_size != sizeof(float)) {
+    return NULL;
+  }
+
+  const size_t elements = (size - sizeof(VectorBody)) / sizeof(float);
+  if (elements != profile_size &&
+      !(elements == LEGACY_PROFILE_SIZE && profile_size <= elements)) {
+    return NULL;
+  }
+
+  return (const float *)(header + 1);
+}
\ No newline at end of file
@@ -22,14 +22,21 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #define NOISE_PROFILE_STATE_H
 
 #include "lv2/urid/urid.h"
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
+#define NOISE_PROFILE_STATE_VERSION 2U
+
 typedef struct NoiseProfileState NoiseProfileState;
 
-NoiseProfileState *noise_profile_state_initialize(LV2_URID child_type);
+NoiseProfileState *noise_profile_state_initialize(LV2_URID child_type,
+                                                  uint32_t profile_size);
 void noise_profile_state_free(NoiseProfileState *self);
 float *noise_profile_get_elements(NoiseProfileState *self);
-size_t noise_profile_get_size();
+const void *noise_profile_get_body(const NoiseProfileState *self);
+size_t noise_profile_get_size(const NoiseProfileState *self);
+const float *noise_profile_state_parse(const void *body, size_t size,
+                                       uint32_t profile_size);
 
 #endif
\ No newline at end of file
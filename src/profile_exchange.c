@@ -0,0 +1,130 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "profile_exchange.h"
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum ExchangeState {
+  EXCHANGE_EMPTY = 0,
+  EXCHANGE_WRITING = 1,
+  EXCHANGE_READY = 2,
+  EXCHANGE_READING = 3,
+} ExchangeState;
+
+struct ProfileExchange {
+  uint32_t profile_size;
+  uint32_t channels;
+  uint32_t averaged_blocks;
+  float *profiles;
+
+  atomic_int state;
+};
+
+ProfileExchange *profile_exchange_initialize(const uint32_t profile_size,
+                                             const uint32_t channels) {
+  ProfileExchange *self =
+      (ProfileExchange *)calloc(1U, sizeof(ProfileExchange));
+  if (!self) {
+    return NULL;
+  }
+
+  self->profile_size = profile_size;
+  self->channels = channels;
+  self->profiles =
+      (float *)calloc((size_t)profile_size * channels, sizeof(float));
+  if (!self->profiles) {
+    free(self);
+    return NULL;
+  }
+
+  atomic_init(&self->state, EXCHANGE_EMPTY);
+
+  return self;
+}
+
+void profile_exchange_free(ProfileExchange *self) {
+  free(self->profiles);
+  free(self);
+}
+
+// Called off the audio thread. Replaces any profile that was not picked up
+// yet and only waits while the audio thread is loading the previous one
+bool profile_exchange_publish(ProfileExchange *self,
+                              const float *const *profiles,
+                              const uint32_t averaged_blocks) {
+  if (!self || !profiles) {
+    return false;
+  }
+
+  for (;;) {
+    int expected = atomic_load_explicit(&self->state, memory_order_acquire);
+    if ((expected == EXCHANGE_EMPTY || expected == EXCHANGE_READY) &&
+        atomic_compare_exchange_weak_explicit(
+            &self->state, &expected, EXCHANGE_WRITING, memory_order_acquire,
+            memory_order_relaxed)) {
+      break;
+    }
+    sched_yield();
+  }
+
+  for (uint32_t channel = 0U; channel < self->channels; channel++) {
+    memcpy(&self->profiles[(size_t)channel * self->profile_size],
+           profiles[channel], sizeof(float) * self->profile_size);
+  }
+  self->averaged_blocks = averaged_blocks;
+
+  atomic_store_explicit(&self->state, EXCHANGE_READY, memory_order_release);
+
+  return true;
+}
+
+// Called off the audio thread, alongside publish. The buffer only changes on
+// the next publish, so a pending profile stays readable after it is claimed
+bool profile_exchange_pending(const ProfileExchange *self) {
+  const int state = atomic_load_explicit(&self->state, memory_order_acquire);
+  return state == EXCHANGE_READY || state == EXCHANGE_READING;
+}
+
+// Called on the audio thread. Never blocks, a profile being written is simply
+// picked up on a later block
+bool profile_exchange_acquire(ProfileExchange *self) {
+  int expected = EXCHANGE_READY;
+  return atomic_compare_exchange_strong_explicit(
+      &self->state, &expected, EXCHANGE_READING, memory_order_acquire,
+      memory_order_relaxed);
+}
+
+const float *profile_exchange_get_profile(const ProfileExchange *self,
+                                          const uint32_t channel) {
+  return &self->profiles[(size_t)channel * self->profile_size];
+}
+
+uint32_t profile_exchange_get_averaged_blocks(const ProfileExchange *self) {
+  return self->averaged_blocks;
+}
+
+void profile_exchange_release(ProfileExchange *self) {
+  atomic_store_explicit(&self->state, EXCHANGE_EMPTY, memory_order_release);
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef PROFILE_EXCHANGE_H
+#define PROFILE_EXCHANGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Hands noise profiles from a non realtime thread to the audio thread. The
+// writer fills a preallocated back buffer and publishes it, the audio thread
+// claims it at a block boundary without locking or allocating.
+
+typedef struct ProfileExchange ProfileExchange;
+
+ProfileExchange *profile_exchange_initialize(uint32_t profile_size,
+                                             uint32_t channels);
+void profile_exchange_free(ProfileExchange *self);
+bool profile_exchange_publish(ProfileExchange *self,
+                              const float *const *profiles,
+                              uint32_t averaged_blocks);
+bool profile_exchange_pending(const ProfileExchange *self);
+bool profile_exchange_acquire(ProfileExchange *self);
+const float *profile_exchange_get_profile(const ProfileExchange *self,
+                                          uint32_t channel);
+uint32_t profile_exchange_get_averaged_blocks(const ProfileExchange *self);
+void profile_exchange_release(ProfileExchange *self);
+
+#endif
\ No newline at end of file
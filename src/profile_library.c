@@ -0,0 +1,502 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#if !defined(_WIN32)
+#if defined(__linux__)
+#define _GNU_SOURCE // MAP_POPULATE
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+#endif
+
+#include "profile_library.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <fcntl.h>
+#include <io.h>
+#include <share.h>
+#include <sys/stat.h>
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define PROFILE_LIBRARY_MAGIC "NRPL"
+#define PROFILE_LIBRARY_VERSION 1U
+#define PROFILE_LIBRARY_FILE_NAME "profiles.nrpl"
+#define PROFILE_LIBRARY_ENV "NOISEREPELLENT_PROFILE_LIBRARY"
+#define PROFILE_LIBRARY_PATH_SIZE 4096U
+
+// Files are written in the byte order of the machine that stores them, a
+// library from a different byte order fails the version check
+typedef struct LibraryHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t count;
+  uint32_t reserved;
+} LibraryHeader;
+
+typedef struct LibraryEntry {
+  char name[PROFILE_LIBRARY_NAME_SIZE];
+  uint32_t name_hash;
+  uint32_t sample_rate;
+  uint32_t fft_size;
+  uint32_t profile_size;
+  uint32_t averaged_blocks;
+  uint32_t reserved;
+  uint64_t offset; // Start of the profile elements from the file start
+} LibraryEntry;
+
+struct ProfileLibrary {
+  const uint8_t *data;
+  size_t size;
+  const LibraryEntry *entries;
+  uint32_t count;
+};
+
+static uint32_t hash_name(const char *name) {
+  uint32_t hash = 2166136261U; // FNV-1a
+  for (uint32_t k = 0U; k < PROFILE_LIBRARY_NAME_SIZE && name[k]; k++) {
+    hash = (hash ^ (uint8_t)name[k]) * 16777619U;
+  }
+  return hash;
+}
+
+static bool map_file(ProfileLibrary *self, const char *path) {
+#if defined(_WIN32)
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+
+  bool success = fseek(file, 0, SEEK_END) == 0;
+  const long size = success ? ftell(file) : -1L;
+  success = size > 0L && fseek(file, 0, SEEK_SET) == 0;
+
+  uint8_t *data = success ? (uint8_t *)malloc((size_t)size) : NULL;
+  success = data && fread(data, 1U, (size_t)size, file) == (size_t)size;
+  fclose(file);
+
+  if (!success) {
+    free(data);
+    return false;
+  }
+
+  self->data = data;
+  self->size = (size_t)size;
+  return true;
+#else
+  const int file = open(path, O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+
+  struct stat status;
+  if (fstat(file, &status) != 0 || status.st_size <= 0) {
+    close(file);
+    return false;
+  }
+
+  int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+  flags |= MAP_POPULATE; // No page faults later on the audio thread
+#endif
+
+  void *data = mmap(NULL, (size_t)status.st_size, PROT_READ, flags, file, 0);
+  close(file);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  self->data = (const uint8_t *)data;
+  self->size = (size_t)status.st_size;
+  return true;
+#endif
+}
+
+static void unmap_file(ProfileLibrary *self) {
+#if defined(_WIN32)
+  free((void *)self->data);
+#else
+  munmap((void *)self->data, self->size);
+#endif
+}
+
+static bool entry_is_valid(const ProfileLibrary *self,
+                           const LibraryEntry *entry) {
+  if (!memchr(entry->name, '\0', PROFILE_LIBRARY_NAME_SIZE) ||
+      entry->name_hash != hash_name(entry->name) ||
+      entry->profile_size == 0U || entry->offset % sizeof(float) != 0U) {
+    return false;
+  }
+
+  const uint64_t bytes = (uint64_t)entry->profile_size * sizeof(float);
+  return entry->offset <= self->size && bytes <= self->size - entry->offset;
+}
+
+ProfileLibrary *profile_library_open(const char *path) {
+  if (!path) {
+    return NULL;
+  }
+
+  ProfileLibrary *self = (ProfileLibrary *)calloc(1U, sizeof(ProfileLibrary));
+  if (!self) {
+    return NULL;
+  }
+
+  if (!map_file(self, path)) {
+    free(self);
+    return NULL;
+  }
+
+  // Everything is checked here so lookups can trust the index
+  const LibraryHeader *header = (const LibraryHeader *)self->data;
+  bool valid = self->size >= sizeof(LibraryHeader) &&
+               memcmp(header->magic, PROFILE_LIBRARY_MAGIC, 4U) == 0 &&
+               header->version == PROFILE_LIBRARY_VERSION &&
+               header->count <= (self->size - sizeof(LibraryHeader)) /
+                                    sizeof(LibraryEntry);
+
+  if (valid) {
+    self->entries = (const LibraryEntry *)(header + 1);
+    self->count = header->count;
+  }
+
+  for (uint32_t k = 0U; valid && k < self->count; k++) {
+    valid = entry_is_valid(self, &self->entries[k]);
+  }
+
+  if (!valid) {
+    profile_library_close(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+void profile_library_close(ProfileLibrary *self) {
+  unmap_file(self);
+  free(self);
+}
+
+uint32_t profile_library_get_count(const ProfileLibrary *self) {
+  return self ? self->count : 0U;
+}
+
+const float *profile_library_find(const ProfileLibrary *self, const char *name,
+                                  const uint32_t sample_rate,
+                                  const uint32_t fft_size,
+                                  uint32_t *profile_size,
+                                  uint32_t *averaged_blocks) {
+  if (!self || !name) {
+    return NULL;
+  }
+
+  const uint32_t name_hash = hash_name(name);
+  for (uint32_t k = 0U; k < self->count; k++) {
+    const LibraryEntry *entry = &self->entries[k];
+    if (entry->name_hash == name_hash && entry->sample_rate == sample_rate &&
+        entry->fft_size == fft_size &&
+        strncmp(entry->name, name, PROFILE_LIBRARY_NAME_SIZE) == 0) {
+      *profile_size = entry->profile_size;
+      *averaged_blocks = entry->averaged_blocks;
+      return (const float *)(self->data + entry->offset);
+    }
+  }
+
+  return NULL;
+}
+
+static void make_parent_directory(const char *path) {
+  char directory[PROFILE_LIBRARY_PATH_SIZE];
+  const char *separator = strrchr(path, '/');
+#if defined(_WIN32)
+  const char *backslash = strrchr(path, '\\');
+  if (!separator || (backslash && backslash > separator)) {
+    separator = backslash;
+  }
+#endif
+  if (!separator || (size_t)(separator - path) >= sizeof(directory)) {
+    return;
+  }
+
+  memcpy(directory, path, (size_t)(separator - path));
+  directory[separator - path] = '\0';
+
+#if defined(_WIN32)
+  _mkdir(directory);
+#else
+  mkdir(directory, 0755);
+#endif
+}
+
+// Record locks belong to the whole process, so instances sharing one also
+// take turns through this mutex
+static pthread_mutex_t store_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Writers of a library take turns through a lock file next to it. The
+// library itself cannot carry the lock since every store replaces its inode
+static int lock_library(const char *path) {
+  char lock_path[PROFILE_LIBRARY_PATH_SIZE];
+  if (snprintf(lock_path, sizeof(lock_path), "%s.lock", path) >=
+      (int)sizeof(lock_path)) {
+    return -1;
+  }
+
+#if defined(_WIN32)
+  int file = -1;
+  if (_sopen_s(&file, lock_path, _O_CREAT | _O_RDWR | _O_BINARY, _SH_DENYNO,
+               _S_IREAD | _S_IWRITE) != 0) {
+    return -1;
+  }
+  // Without LOCKFILE_FAIL_IMMEDIATELY this sleeps until the holder unlocks
+  OVERLAPPED overlapped;
+  memset(&overlapped, 0, sizeof(overlapped));
+  if (!LockFileEx((HANDLE)_get_osfhandle(file), LOCKFILE_EXCLUSIVE_LOCK, 0U,
+                  1U, 0U, &overlapped)) {
+    _close(file);
+    return -1;
+  }
+#else
+  const int file = open(lock_path, O_RDWR | O_CREAT, 0644);
+  if (file < 0) {
+    return -1;
+  }
+
+  struct flock lock;
+  memset(&lock, 0, sizeof(lock));
+  lock.l_type = F_WRLCK;
+  lock.l_whence = SEEK_SET;
+  while (fcntl(file, F_SETLKW, &lock) != 0) {
+    if (errno != EINTR) {
+      close(file);
+      return -1;
+    }
+  }
+#endif
+
+  return file;
+}
+
+// Closing the lock file releases the lock
+static void unlock_library(const int file) {
+#if defined(_WIN32)
+  OVERLAPPED overlapped;
+  memset(&overlapped, 0, sizeof(overlapped));
+  UnlockFileEx((HANDLE)_get_osfhandle(file), 0U, 1U, 0U, &overlapped);
+  _close(file);
+#else
+  close(file);
+#endif
+}
+
+// A uniquely named file in the directory of the library, so the final rename
+// never crosses file systems and concurrent writers never share it
+static FILE *open_temporary(const char *path, char *temporary_path,
+                            const size_t size) {
+  if (snprintf(temporary_path, size, "%s.XXXXXX", path) >= (int)size) {
+    return NULL;
+  }
+
+#if defined(_WIN32)
+  int file = -1;
+  if (_mktemp_s(temporary_path, size) != 0 ||
+      _sopen_s(&file, temporary_path,
+               _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY, _SH_DENYNO,
+               _S_IREAD | _S_IWRITE) != 0) {
+    return NULL;
+  }
+  FILE *stream = _fdopen(file, "wb");
+  if (!stream) {
+    _close(file);
+  }
+#else
+  const int file = mkstemp(temporary_path);
+  if (file < 0) {
+    return NULL;
+  }
+  fchmod(file, 0644); // mkstemp() creates files only the owner can read
+  FILE *stream = fdopen(file, "wb");
+  if (!stream) {
+    close(file);
+  }
+#endif
+
+  if (!stream) {
+    remove(temporary_path);
+  }
+  return stream;
+}
+
+static bool write_entry_data(FILE *file, const LibraryEntry *entry,
+                             const float *profile) {
+  return fwrite(profile, sizeof(float), entry->profile_size, file) ==
+         entry->profile_size;
+}
+
+static bool store_locked(const char *path, const char *name,
+                         const uint32_t sample_rate, const uint32_t fft_size,
+                         const float *profile, const uint32_t profile_size,
+                         const uint32_t averaged_blocks) {
+  ProfileLibrary *previous = profile_library_open(path);
+  const uint32_t previous_count = profile_library_get_count(previous);
+
+  LibraryEntry *entries =
+      (LibraryEntry *)calloc(previous_count + 1U, sizeof(LibraryEntry));
+  const float **profiles =
+      (const float **)calloc(previous_count + 1U, sizeof(float *));
+  if (!entries || !profiles) {
+    free(entries);
+    free(profiles);
+    if (previous) {
+      profile_library_close(previous);
+    }
+    return false;
+  }
+
+  uint32_t count = 0U;
+  for (uint32_t k = 0U; k < previous_count; k++) {
+    const LibraryEntry *entry = &previous->entries[k];
+    const bool replaced = entry->sample_rate == sample_rate &&
+                          entry->fft_size == fft_size &&
+                          strcmp(entry->name, name) == 0;
+    if (!replaced) {
+      entries[count] = *entry;
+      profiles[count] = (const float *)(previous->data + entry->offset);
+      count++;
+    }
+  }
+
+  LibraryEntry *entry = &entries[count];
+  strcpy(entry->name, name);
+  entry->name_hash = hash_name(name);
+  entry->sample_rate = sample_rate;
+  entry->fft_size = fft_size;
+  entry->profile_size = profile_size;
+  entry->averaged_blocks = averaged_blocks;
+  profiles[count] = profile;
+  count++;
+
+  uint64_t offset = sizeof(LibraryHeader) + sizeof(LibraryEntry) * count;
+  for (uint32_t k = 0U; k < count; k++) {
+    entries[k].offset = offset;
+    offset += (uint64_t)entries[k].profile_size * sizeof(float);
+  }
+
+  LibraryHeader header = {.version = PROFILE_LIBRARY_VERSION, .count = count};
+  memcpy(header.magic, PROFILE_LIBRARY_MAGIC, 4U);
+
+  char temporary_path[PROFILE_LIBRARY_PATH_SIZE];
+  FILE *file = open_temporary(path, temporary_path, sizeof(temporary_path));
+  bool success = file != NULL;
+
+  if (success) {
+    success = fwrite(&header, sizeof(header), 1U, file) == 1U &&
+              fwrite(entries, sizeof(LibraryEntry), count, file) == count;
+    for (uint32_t k = 0U; success && k < count; k++) {
+      success = write_entry_data(file, &entries[k], profiles[k]);
+    }
+    success = fclose(file) == 0 && success;
+  }
+
+  if (previous) {
+    profile_library_close(previous);
+  }
+  free(entries);
+  free(profiles);
+
+  if (success) {
+#if defined(_WIN32)
+    remove(path); // rename() does not replace files on Windows
+#endif
+    success = rename(temporary_path, path) == 0;
+  }
+  if (!success && file) {
+    remove(temporary_path);
+  }
+
+  return success;
+}
+
+// Rewrites the whole library next to the old one and renames it over it, so
+// instances that have the previous file mapped keep a consistent view. The
+// read, merge and rename happen under the lock so no store is lost
+bool profile_library_store(const char *path, const char *name,
+                           const uint32_t sample_rate, const uint32_t fft_size,
+                           const float *profile, const uint32_t profile_size,
+                           const uint32_t averaged_blocks) {
+  if (!path || !name || !profile || profile_size == 0U ||
+      strlen(name) >= PROFILE_LIBRARY_NAME_SIZE) {
+    return false;
+  }
+
+  make_parent_directory(path);
+
+  pthread_mutex_lock(&store_lock);
+  const int lock = lock_library(path);
+  const bool success =
+      lock >= 0 && store_locked(path, name, sample_rate, fft_size, profile,
+                                profile_size, averaged_blocks);
+  if (lock >= 0) {
+    unlock_library(lock);
+  }
+  pthread_mutex_unlock(&store_lock);
+
+  return success;
+}
+
+bool profile_library_default_path(char *path, const size_t size) {
+  const char *explicit_path = getenv(PROFILE_LIBRARY_ENV);
+  if (explicit_path && explicit_path[0]) {
+    return snprintf(path, size, "%s", explicit_path) < (int)size;
+  }
+
+#if defined(_WIN32)
+  const char *data_home = getenv("APPDATA");
+  if (!data_home) {
+    return false;
+  }
+  return snprintf(path, size, "%s\\noise-repellent\\%s", data_home,
+                  PROFILE_LIBRARY_FILE_NAME) < (int)size;
+#else
+  const char *data_home = getenv("XDG_DATA_HOME");
+  if (data_home && data_home[0]) {
+    return snprintf(path, size, "%s/noise-repellent/%s", data_home,
+                    PROFILE_LIBRARY_FILE_NAME) < (int)size;
+  }
+
+  const char *home = getenv("HOME");
+  if (!home) {
+    return false;
+  }
+  return snprintf(path, size, "%s/.local/share/noise-repellent/%s", home,
+                  PROFILE_LIBRARY_FILE_NAME) < (int)size;
+#endif
+}
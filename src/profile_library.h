@@ -0,0 +1,49 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef PROFILE_LIBRARY_H
+#define PROFILE_LIBRARY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Named noise profiles kept in a single memory mapped file. The index is
+// validated once when the file is opened, so finding a profile afterwards
+// only touches mapped memory and is safe on the audio thread.
+
+#define PROFILE_LIBRARY_NAME_SIZE 64U
+
+typedef struct ProfileLibrary ProfileLibrary;
+
+ProfileLibrary *profile_library_open(const char *path);
+void profile_library_close(ProfileLibrary *self);
+uint32_t profile_library_get_count(const ProfileLibrary *self);
+const float *profile_library_find(const ProfileLibrary *self, const char *name,
+                                  uint32_t sample_rate, uint32_t fft_size,
+                                  uint32_t *profile_size,
+                                  uint32_t *averaged_blocks);
+bool profile_library_store(const char *path, const char *name,
+                           uint32_t sample_rate, uint32_t fft_size,
+                           const float *profile, uint32_t profile_size,
+                           uint32_t averaged_blocks);
+bool profile_library_default_path(char *path, size_t size);
+
+#endif
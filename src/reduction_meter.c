@@ -0,0 +1,114 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "reduction_meter.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define METER_RATE_HZ 30.F
+#define AVERAGE_TIME_S 0.3F
+#define PEAK_HOLD_S 1.F
+#define PEAK_RELEASE_DB_PER_S 20.F
+#define ENERGY_FLOOR 1e-10F
+
+struct ReductionMeter {
+  float sample_rate;
+  uint32_t interval; // Samples between two metered blocks
+  uint32_t samples_since_update;
+  uint32_t samples_since_peak;
+
+  float dry_energy;
+  float wet_energy;
+  bool measured;
+
+  float average;
+  float peak;
+};
+
+ReductionMeter *reduction_meter_initialize(const uint32_t sample_rate) {
+  ReductionMeter *self = (ReductionMeter *)calloc(1U, sizeof(ReductionMeter));
+  if (!self) {
+    return NULL;
+  }
+
+  self->sample_rate = (float)sample_rate;
+  self->interval = (uint32_t)(self->sample_rate / METER_RATE_HZ);
+
+  return self;
+}
+
+void reduction_meter_free(ReductionMeter *self) { free(self); }
+
+// Returns whether this block should be measured and closed with an update
+bool reduction_meter_start_block(ReductionMeter *self,
+                                 const uint32_t number_of_samples) {
+  self->samples_since_update += number_of_samples;
+  self->samples_since_peak += number_of_samples;
+
+  if (self->samples_since_update < self->interval) {
+    return false;
+  }
+
+  self->dry_energy = 0.F;
+  self->wet_energy = 0.F;
+  self->measured = false;
+  return true;
+}
+
+void reduction_meter_add(ReductionMeter *self, const float dry_energy,
+                         const float wet_energy) {
+  self->dry_energy += dry_energy;
+  self->wet_energy += wet_energy;
+  self->measured = true;
+}
+
+void reduction_meter_update(ReductionMeter *self) {
+  const float elapsed_s =
+      (float)self->samples_since_update / self->sample_rate;
+  self->samples_since_update = 0U;
+
+  // Nothing measured means the engine was bypassed for the whole block
+  float reduction = 0.F;
+  if (self->measured) {
+    reduction = 10.F * log10f((self->dry_energy + ENERGY_FLOOR) /
+                              (self->wet_energy + ENERGY_FLOOR));
+    reduction = fmaxf(reduction, 0.F);
+  }
+
+  const float coefficient = 1.F - expf(-elapsed_s / AVERAGE_TIME_S);
+  self->average += coefficient * (reduction - self->average);
+
+  if (reduction >= self->peak) {
+    self->peak = reduction;
+    self->samples_since_peak = 0U;
+  } else if ((float)self->samples_since_peak >
+             PEAK_HOLD_S * self->sample_rate) {
+    self->peak =
+        fmaxf(self->peak - PEAK_RELEASE_DB_PER_S * elapsed_s, reduction);
+  }
+}
+
+float reduction_meter_get_average(const ReductionMeter *self) {
+  return self->average;
+}
+
+float reduction_meter_get_peak(const ReductionMeter *self) {
+  return self->peak;
+}
@@ -0,0 +1,41 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef REDUCTION_METER_H
+#define REDUCTION_METER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Broadband gain reduction metered at a bounded rate. Only the blocks it asks
+// for are measured, everything in between costs a counter update.
+
+typedef struct ReductionMeter ReductionMeter;
+
+ReductionMeter *reduction_meter_initialize(uint32_t sample_rate);
+void reduction_meter_free(ReductionMeter *self);
+bool reduction_meter_start_block(ReductionMeter *self,
+                                 uint32_t number_of_samples);
+void reduction_meter_add(ReductionMeter *self, float dry_energy,
+                         float wet_energy);
+void reduction_meter_update(ReductionMeter *self);
+float reduction_meter_get_average(const ReductionMeter *self);
+float reduction_meter_get_peak(const ReductionMeter *self);
+#endif
@@ -19,7 +19,7 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 */
 
 #include "signal_crossfade.h"
-#include <float.h>
+#include "gain_ramp.h"
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,36 +29,49 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 #endif
 
 #define RELEASE_TIME_MS 30.F
+#define BYPASS_THRESHOLD 1e-4F
 
 struct SignalCrossfade {
-  float tau;
-  float wet_dry_target;
-  float wet_dry;
+  GainRamp *wet_dry;
+
+  // Dry signal ring, delayed by the processing latency to stay aligned
+  float *dry_buffer;
+  uint32_t latency;
+  uint32_t position;
 };
 
-SignalCrossfade *signal_crossfade_initialize(const uint32_t sample_rate) {
+SignalCrossfade *signal_crossfade_initialize(const uint32_t sample_rate,
+                                             const uint32_t latency) {
   SignalCrossfade *self =
       (SignalCrossfade *)calloc(1U, sizeof(SignalCrossfade));
+  if (!self) {
+    return NULL;
+  }
+
+  // Time constant of 1 / (pi * RELEASE_TIME_MS) seconds, about 10 ms
+  const float decay = expf(-M_PI * RELEASE_TIME_MS / (float)sample_rate);
+  self->wet_dry = gain_ramp_initialize(decay, 0.F);
+  if (!self->wet_dry) {
+    free(self);
+    return NULL;
+  }
 
-  self->tau =
-      (1.F - expf(-128.F * M_PI * RELEASE_TIME_MS / (float)sample_rate));
-  self->wet_dry = 0.F;
-  self->wet_dry_target = 0.F;
+  self->latency = latency;
+  if (latency > 0U) {
+    self->dry_buffer = (float *)calloc(latency, sizeof(float));
+    if (!self->dry_buffer) {
+      signal_crossfade_free(self);
+      return NULL;
+    }
+  }
 
   return self;
 }
 
-void signal_crossfade_free(SignalCrossfade *self) { free(self); }
-
-static void signal_crossfade_update_wetdry_target(SignalCrossfade *self,
-                                                  const bool enable) {
-  if (enable) {
-    self->wet_dry_target = 1.F;
-  } else {
-    self->wet_dry_target = 0.F;
-  }
-
-  self->wet_dry += self->tau * (self->wet_dry_target - self->wet_dry) + FLT_MIN;
+void signal_crossfade_free(SignalCrossfade *self) {
+  gain_ramp_free(self->wet_dry);
+  free(self->dry_buffer);
+  free(self);
 }
 
 bool signal_crossfade_run(SignalCrossfade *self,
@@ -68,11 +81,118 @@ bool signal_crossfade_run(SignalCrossfade *self,
     return false;
   }
 
-  signal_crossfade_update_wetdry_target(self, enable);
+  gain_ramp_set_target(self->wet_dry, enable ? 1.F : 0.F);
 
-  for (uint32_t k = 0U; k < number_of_samples; k++) {
-    output[k] = (1.F - self->wet_dry) * input[k] + output[k] * self->wet_dry;
+  if (self->latency == 0U) {
+    gain_ramp_mix(self->wet_dry, number_of_samples, input, output, output);
+    return true;
+  }
+
+  // Walk the ring in contiguous segments so the mix has no wrapping
+  uint32_t k = 0U;
+  while (k < number_of_samples) {
+    uint32_t segment = self->latency - self->position;
+    if (segment > number_of_samples - k) {
+      segment = number_of_samples - k;
+    }
+
+    float *dry = self->dry_buffer + self->position;
+    gain_ramp_mix(self->wet_dry, segment, dry, output + k, output + k);
+    memcpy(dry, input + k, sizeof(float) * segment);
+
+    k += segment;
+    self->position = (self->position + segment) % self->latency;
   }
 
   return true;
-}
\ No newline at end of file
+}
+
+bool signal_crossfade_bypass(SignalCrossfade *self,
+                             const uint32_t number_of_samples,
+                             const float *input, float *output) {
+  if (!input || !output || number_of_samples <= 0U) {
+    return false;
+  }
+
+  if (self->latency == 0U) {
+    if (input != output) {
+      memcpy(output, input, sizeof(float) * number_of_samples);
+    }
+    return true;
+  }
+
+  uint32_t k = 0U;
+  while (k < number_of_samples) {
+    uint32_t segment = self->latency - self->position;
+    if (segment > number_of_samples - k) {
+      segment = number_of_samples - k;
+    }
+
+    float *dry = self->dry_buffer + self->position;
+    for (uint32_t i = 0U; i < segment; i++) {
+      const float delayed = dry[i];
+      dry[i] = input[k + i];
+      output[k + i] = delayed;
+    }
+
+    k += segment;
+    self->position = (self->position + segment) % self->latency;
+  }
+
+  return true;
+}
+
+bool signal_crossfade_is_bypassed(const SignalCrossfade *self) {
+  return gain_ramp_get_target(self->wet_dry) == 0.F &&
+         gain_ramp_get_gain(self->wet_dry) < BYPASS_THRESHOLD;
+}
+
+uint32_t signal_crossfade_get_latency(const SignalCrossfade *self) {
+  return self->latency;
+}
+
+void signal_crossfade_get_dry_history(const SignalCrossfade *self,
+                                      float *history) {
+  if (self->latency == 0U) {
+    return;
+  }
+
+  const uint32_t oldest = self->latency - self->position;
+  memcpy(history, self->dry_buffer + self->position, sizeof(float) * oldest);
+  memcpy(history + oldest, self->dry_buffer, sizeof(float) * self->position);
+}
+
+// Energy of the processed block and of the dry signal it lines up with. Has
+// to be called before signal_crossfade_run() moves the dry ring forward
+void signal_crossfade_measure(const SignalCrossfade *self,
+                              const uint32_t number_of_samples,
+                              const float *input, const float *wet,
+                              float *dry_energy, float *wet_energy) {
+  float dry_sum = 0.F;
+  float wet_sum = 0.F;
+
+  for (uint32_t k = 0U; k < number_of_samples; k++) {
+    wet_sum += wet[k] * wet[k];
+  }
+
+  // Blocks aligned to the ring read it in one piece, others wrap once
+  const uint32_t from_ring =
+      number_of_samples < self->latency ? number_of_samples : self->latency;
+  uint32_t segment = self->latency - self->position;
+  if (segment > from_ring) {
+    segment = from_ring;
+  }
+
+  for (uint32_t k = self->position; k < self->position + segment; k++) {
+    dry_sum += self->dry_buffer[k] * self->dry_buffer[k];
+  }
+  for (uint32_t k = 0U; k < from_ring - segment; k++) {
+    dry_sum += self->dry_buffer[k] * self->dry_buffer[k];
+  }
+  for (uint32_t k = 0U; k < number_of_samples - from_ring; k++) {
+    dry_sum += input[k] * input[k];
+  }
+
+  *dry_energy += dry_sum;
+  *wet_energy += wet_sum;
+}
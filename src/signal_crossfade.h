@@ -26,8 +26,19 @@ Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
 
 typedef struct SignalCrossfade SignalCrossfade;
 
-SignalCrossfade *signal_crossfade_initialize(uint32_t sample_rate);
+SignalCrossfade *signal_crossfade_initialize(uint32_t sample_rate,
+                                             uint32_t latency);
 void signal_crossfade_free(SignalCrossfade *self);
 bool signal_crossfade_run(SignalCrossfade *self, uint32_t number_of_samples,
                           const float *input, float *output, bool enable);
-#endif
\ No newline at end of file
+bool signal_crossfade_bypass(SignalCrossfade *self, uint32_t number_of_samples,
+                             const float *input, float *output);
+bool signal_crossfade_is_bypassed(const SignalCrossfade *self);
+uint32_t signal_crossfade_get_latency(const SignalCrossfade *self);
+void signal_crossfade_get_dry_history(const SignalCrossfade *self,
+                                      float *history);
+void signal_crossfade_measure(const SignalCrossfade *self,
+                              uint32_t number_of_samples, const float *input,
+                              const float *wet, float *dry_energy,
+                              float *wet_energy);
+#endif
@@ -0,0 +1,107 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "spectrum_decimator.h"
+#include <math.h>
+#include <stdlib.h>
+
+#define POWER_FLOOR 1e-20F
+
+struct SpectrumDecimator {
+  uint32_t spectrum_size;
+  uint32_t number_of_bands;
+  uint32_t *band_edges; // First bin of every band plus the end of the last
+  float *bands;
+};
+
+SpectrumDecimator *
+spectrum_decimator_initialize(const uint32_t spectrum_size,
+                              const uint32_t number_of_bands) {
+  if (spectrum_size < 2U || number_of_bands == 0U) {
+    return NULL;
+  }
+
+  SpectrumDecimator *self =
+      (SpectrumDecimator *)calloc(1U, sizeof(SpectrumDecimator));
+  if (!self) {
+    return NULL;
+  }
+
+  self->spectrum_size = spectrum_size;
+  self->band_edges =
+      (uint32_t *)calloc(number_of_bands + 1U, sizeof(uint32_t));
+  self->bands = (float *)calloc(number_of_bands, sizeof(float));
+  if (!self->band_edges || !self->bands) {
+    spectrum_decimator_free(self);
+    return NULL;
+  }
+
+  // Bands start above DC and span up to Nyquist, every one at least a bin
+  // wide. Short spectra end up with fewer bands than asked for
+  const float last_bin = (float)(spectrum_size - 1U);
+  self->band_edges[0] = 1U;
+  uint32_t band = 0U;
+  while (band < number_of_bands && self->band_edges[band] < spectrum_size) {
+    uint32_t edge = (uint32_t)lroundf(
+        powf(last_bin, (float)(band + 1U) / (float)number_of_bands));
+    if (edge <= self->band_edges[band]) {
+      edge = self->band_edges[band] + 1U;
+    }
+    if (edge > spectrum_size) {
+      edge = spectrum_size;
+    }
+
+    self->band_edges[++band] = edge;
+  }
+  self->band_edges[band] = spectrum_size;
+  self->number_of_bands = band;
+
+  return self;
+}
+
+void spectrum_decimator_free(SpectrumDecimator *self) {
+  free(self->band_edges);
+  free(self->bands);
+  free(self);
+}
+
+void spectrum_decimator_run(SpectrumDecimator *self, const float *spectrum) {
+  for (uint32_t b = 0U; b < self->number_of_bands; b++) {
+    const uint32_t first = self->band_edges[b];
+    const uint32_t last = self->band_edges[b + 1U];
+
+    float power = 0.F;
+    for (uint32_t k = first; k < last; k++) {
+      power += spectrum[k];
+    }
+
+    self->bands[b] =
+        10.F * log10f(power / (float)(last - first) + POWER_FLOOR);
+  }
+}
+
+const float *spectrum_decimator_get_bands(const SpectrumDecimator *self) {
+  return self->bands;
+}
+
+uint32_t
+spectrum_decimator_get_number_of_bands(const SpectrumDecimator *self) {
+  return self->number_of_bands;
+}
@@ -0,0 +1,37 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef SPECTRUM_DECIMATOR_H
+#define SPECTRUM_DECIMATOR_H
+
+#include <stdint.h>
+
+// Folds a power spectrum into logarithmically spaced bands in dB, small
+// enough to be sent to a host UI
+
+typedef struct SpectrumDecimator SpectrumDecimator;
+
+SpectrumDecimator *spectrum_decimator_initialize(uint32_t spectrum_size,
+                                                 uint32_t number_of_bands);
+void spectrum_decimator_free(SpectrumDecimator *self);
+void spectrum_decimator_run(SpectrumDecimator *self, const float *spectrum);
+const float *spectrum_decimator_get_bands(const SpectrumDecimator *self);
+uint32_t spectrum_decimator_get_number_of_bands(const SpectrumDecimator *self);
+#endif
@@ -0,0 +1,381 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "timing_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(NOISEREPELLENT_TIMING_TRACE)
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+#define TIMING_TRACE_ENV "NOISEREPELLENT_TIMING_TRACE"
+#define RING_SIZE 16384U // Power of two, several drain intervals of tiny blocks
+#define HISTOGRAM_BUCKETS 32U
+#define DRAIN_INTERVAL_MS 100L
+#define REPORT_INTERVAL_MS 1000L
+#define MAX_PATH_SIZE 4096U
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct TimingRecord {
+  uint64_t ticks[TIMING_SECTIONS];
+  uint32_t number_of_samples;
+} TimingRecord;
+
+// Bucket k counts durations in [2^k, 2^(k+1)) nanoseconds
+typedef struct Histogram {
+  uint64_t buckets[HISTOGRAM_BUCKETS];
+  uint64_t count;
+  double total_ns;
+  double audio_ns;
+  double max_ns;
+  uint64_t over_deadline;
+} Histogram;
+
+struct TimingTrace {
+  // Single producer (the audio thread), single consumer (the report thread).
+  // The padding keeps each side on its own cache line so pushing does not
+  // bounce the line the report thread writes
+  atomic_uint head;
+  uint32_t cached_tail; // Last tail seen by the producer
+  uint64_t pending[TIMING_SECTIONS]; // Sections of the block being timed
+  uint64_t block_start;
+  uint64_t last_mark;
+  atomic_uint dropped;
+  char padding[CACHE_LINE_SIZE];
+  atomic_uint tail;
+  char tail_padding[CACHE_LINE_SIZE];
+  TimingRecord ring[RING_SIZE];
+
+  char name[256];
+  char path[MAX_PATH_SIZE];
+  double sample_rate;
+  Histogram histograms[TIMING_SECTIONS];
+
+  uint64_t start_ticks;
+  double start_ns;
+
+  pthread_t thread;
+  bool thread_started;
+  atomic_bool quit;
+};
+
+static const char *const section_names[TIMING_SECTIONS] = {
+    "block",
+    "process",
+    "crossfade",
+};
+
+static atomic_uint next_instance = 0U;
+
+// Raw counter ticks, converted to nanoseconds off the audio thread
+static inline uint64_t read_ticks(void) {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+  return (uint64_t)__rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000U + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static double monotonic_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+static void sleep_ms(const long milliseconds) {
+  const struct timespec duration = {
+      .tv_sec = milliseconds / 1000L,
+      .tv_nsec = (milliseconds % 1000L) * 1000000L,
+  };
+  nanosleep(&duration, NULL);
+}
+
+// The tick rate is measured against the monotonic clock over the whole
+// lifetime of the trace, so it gets more precise the longer it runs
+static double ns_per_tick(const TimingTrace *self) {
+  const uint64_t ticks = read_ticks() - self->start_ticks;
+  const double elapsed_ns = monotonic_ns() - self->start_ns;
+  return ticks > 0U ? elapsed_ns / (double)ticks : 1.0;
+}
+
+static uint32_t bucket_for(const double ns) {
+  uint32_t bucket = 0U;
+  uint64_t value = (uint64_t)ns;
+  while (value > 1U && bucket < HISTOGRAM_BUCKETS - 1U) {
+    value >>= 1U;
+    bucket++;
+  }
+  return bucket;
+}
+
+static void drain(TimingTrace *self, const double tick_ns) {
+  const uint32_t head = atomic_load_explicit(&self->head, memory_order_acquire);
+  uint32_t tail = atomic_load_explicit(&self->tail, memory_order_relaxed);
+
+  for (; tail != head; tail++) {
+    const TimingRecord *record = &self->ring[tail & (RING_SIZE - 1U)];
+    const double audio_ns =
+        (double)record->number_of_samples * 1e9 / self->sample_rate;
+
+    for (uint32_t s = 0U; s < TIMING_SECTIONS; s++) {
+      Histogram *histogram = &self->histograms[s];
+      const double ns = (double)record->ticks[s] * tick_ns;
+
+      histogram->buckets[bucket_for(ns)]++;
+      histogram->count++;
+      histogram->total_ns += ns;
+      histogram->audio_ns += audio_ns;
+      if (ns > histogram->max_ns) {
+        histogram->max_ns = ns;
+      }
+      if (ns > audio_ns) {
+        histogram->over_deadline++;
+      }
+    }
+  }
+
+  atomic_store_explicit(&self->tail, tail, memory_order_release);
+}
+
+static double percentile_ns(const Histogram *histogram, const double rank) {
+  const uint64_t target = (uint64_t)(rank * (double)histogram->count);
+  uint64_t seen = 0U;
+
+  for (uint32_t k = 0U; k < HISTOGRAM_BUCKETS; k++) {
+    seen += histogram->buckets[k];
+    if (seen > target) {
+      return (double)(2ULL << k);
+    }
+  }
+  return histogram->max_ns;
+}
+
+// Rewritten as a whole through a temporary file so readers never see a
+// partial report
+static void write_report(const TimingTrace *self) {
+  char temporary[MAX_PATH_SIZE + 4U];
+  snprintf(temporary, sizeof(temporary), "%s.tmp", self->path);
+
+  FILE *file = fopen(temporary, "w");
+  if (!file) {
+    return;
+  }
+
+  fprintf(file, "# noise-repellent timing trace\n");
+  fprintf(file, "instance %s\n", self->name);
+  fprintf(file, "sample_rate %.0f\n", self->sample_rate);
+  fprintf(file, "dropped %u\n",
+          atomic_load_explicit(&self->dropped, memory_order_relaxed));
+
+  for (uint32_t s = 0U; s < TIMING_SECTIONS; s++) {
+    const Histogram *histogram = &self->histograms[s];
+    if (histogram->count == 0U) {
+      continue;
+    }
+
+    fprintf(file,
+            "\nsection %s\ncount %llu\nmean_ns %.0f\np50_ns %.0f\n"
+            "p99_ns %.0f\np999_ns %.0f\nmax_ns %.0f\nover_deadline %llu\n"
+            "load %.4f\n",
+            section_names[s], (unsigned long long)histogram->count,
+            histogram->total_ns / (double)histogram->count,
+            percentile_ns(histogram, 0.5), percentile_ns(histogram, 0.99),
+            percentile_ns(histogram, 0.999), histogram->max_ns,
+            (unsigned long long)histogram->over_deadline,
+            histogram->total_ns / histogram->audio_ns);
+
+    fprintf(file, "bucket_ns count\n");
+    for (uint32_t k = 0U; k < HISTOGRAM_BUCKETS; k++) {
+      if (histogram->buckets[k] > 0U) {
+        fprintf(file, "%llu %llu\n", 1ULL << k,
+                (unsigned long long)histogram->buckets[k]);
+      }
+    }
+  }
+
+  fclose(file);
+  rename(temporary, self->path);
+}
+
+static void *report_thread(void *data) {
+  TimingTrace *self = (TimingTrace *)data;
+  long since_report = 0L;
+
+  while (!atomic_load_explicit(&self->quit, memory_order_acquire)) {
+    sleep_ms(DRAIN_INTERVAL_MS);
+    drain(self, ns_per_tick(self));
+
+    since_report += DRAIN_INTERVAL_MS;
+    if (since_report >= REPORT_INTERVAL_MS) {
+      write_report(self);
+      since_report = 0L;
+    }
+  }
+
+  drain(self, ns_per_tick(self));
+  write_report(self);
+
+  return NULL;
+}
+
+TimingTrace *timing_trace_initialize(const char *name,
+                                     const uint32_t sample_rate) {
+  const char *directory = getenv(TIMING_TRACE_ENV);
+  if (!directory || directory[0] == '\0' || sample_rate == 0U) {
+    return NULL;
+  }
+
+  TimingTrace *self = (TimingTrace *)calloc(1U, sizeof(TimingTrace));
+  if (!self) {
+    return NULL;
+  }
+
+  const unsigned int instance = atomic_fetch_add(&next_instance, 1U);
+  snprintf(self->name, sizeof(self->name), "%s %u", name, instance);
+  if (snprintf(self->path, sizeof(self->path), "%s/nrepellent-%ld-%u.trace",
+               directory, (long)getpid(),
+               instance) >= (int)sizeof(self->path)) {
+    free(self);
+    return NULL;
+  }
+
+  self->sample_rate = (double)sample_rate;
+  atomic_init(&self->head, 0U);
+  atomic_init(&self->tail, 0U);
+  atomic_init(&self->dropped, 0U);
+  atomic_init(&self->quit, false);
+
+  self->start_ticks = read_ticks();
+  self->start_ns = monotonic_ns();
+
+  if (pthread_create(&self->thread, NULL, report_thread, self) != 0) {
+    timing_trace_free(self);
+    return NULL;
+  }
+  self->thread_started = true;
+
+  return self;
+}
+
+void timing_trace_free(TimingTrace *self) {
+  if (!self) {
+    return;
+  }
+
+  if (self->thread_started) {
+    atomic_store_explicit(&self->quit, true, memory_order_release);
+    pthread_join(self->thread, NULL);
+  }
+
+  free(self);
+}
+
+void timing_trace_mark_block(TimingTrace *self) {
+  self->block_start = read_ticks();
+  self->last_mark = self->block_start;
+}
+
+void timing_trace_mark_section(TimingTrace *self,
+                               const TimingSection section) {
+  const uint64_t now = read_ticks();
+  self->pending[section] += now - self->last_mark;
+  self->last_mark = now;
+}
+
+// Realtime safe, a full ring drops the record instead of waiting. The shared
+// tail is only read again when the cached one says the ring is full
+void timing_trace_push(TimingTrace *self, const uint32_t number_of_samples) {
+  const uint32_t head = atomic_load_explicit(&self->head, memory_order_relaxed);
+
+  if (head - self->cached_tail >= RING_SIZE) {
+    self->cached_tail =
+        atomic_load_explicit(&self->tail, memory_order_acquire);
+  }
+
+  if (head - self->cached_tail >= RING_SIZE) {
+    atomic_fetch_add_explicit(&self->dropped, 1U, memory_order_relaxed);
+  } else {
+    TimingRecord *record = &self->ring[head & (RING_SIZE - 1U)];
+    record->ticks[TIMING_SECTION_BLOCK] = read_ticks() - self->block_start;
+    record->ticks[TIMING_SECTION_PROCESS] =
+        self->pending[TIMING_SECTION_PROCESS];
+    record->ticks[TIMING_SECTION_CROSSFADE] =
+        self->pending[TIMING_SECTION_CROSSFADE];
+    record->number_of_samples = number_of_samples;
+
+    atomic_store_explicit(&self->head, head + 1U, memory_order_release);
+  }
+
+  for (uint32_t s = 0U; s < TIMING_SECTIONS; s++) {
+    self->pending[s] = 0U;
+  }
+}
+
+#else
+
+TimingTrace *timing_trace_initialize(const char *name,
+                                     const uint32_t sample_rate) {
+  (void)name;
+  (void)sample_rate;
+  return NULL;
+}
+
+void timing_trace_free(TimingTrace *self) { (void)self; }
+
+void timing_trace_mark_block(TimingTrace *self) { (void)self; }
+
+void timing_trace_mark_section(TimingTrace *self,
+                               const TimingSection section) {
+  (void)self;
+  (void)section;
+}
+
+void timing_trace_push(TimingTrace *self, const uint32_t number_of_samples) {
+  (void)self;
+  (void)number_of_samples;
+}
+
+#endif
@@ -0,0 +1,85 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef TIMING_TRACE_H
+#define TIMING_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Opt-in timing of the realtime path. The audio thread marks the end of each
+// section, every section counts the time since the previous mark, and one
+// record per block goes into a lock-free ring. A background thread drains it
+// into histograms and rewrites a report per instance in the directory set in
+// NOISEREPELLENT_TIMING_TRACE. Builds without the timing_trace option, the
+// default, compile every call below to nothing.
+
+typedef enum TimingSection {
+  TIMING_SECTION_BLOCK = 0,
+  TIMING_SECTION_PROCESS = 1,
+  TIMING_SECTION_CROSSFADE = 2,
+  TIMING_SECTIONS = 3,
+} TimingSection;
+
+typedef struct TimingTrace TimingTrace;
+
+TimingTrace *timing_trace_initialize(const char *name, uint32_t sample_rate);
+void timing_trace_free(TimingTrace *self);
+void timing_trace_mark_block(TimingTrace *self);
+void timing_trace_mark_section(TimingTrace *self, TimingSection section);
+void timing_trace_push(TimingTrace *self, uint32_t number_of_samples);
+
+static inline void timing_trace_begin(TimingTrace *self) {
+#if defined(NOISEREPELLENT_TIMING_TRACE)
+  if (self) {
+    timing_trace_mark_block(self);
+  }
+#else
+  (void)self;
+#endif
+}
+
+static inline void timing_trace_lap(TimingTrace *self,
+                                    const TimingSection section) {
+#if defined(NOISEREPELLENT_TIMING_TRACE)
+  if (self) {
+    timing_trace_mark_section(self, section);
+  }
+#else
+  (void)self;
+  (void)section;
+#endif
+}
+
+// Closes the block, it has to be the last thing run() does so the block time
+// covers the meters and notifications too
+static inline void timing_trace_commit(TimingTrace *self,
+                                       const uint32_t number_of_samples) {
+#if defined(NOISEREPELLENT_TIMING_TRACE)
+  if (self) {
+    timing_trace_push(self, number_of_samples);
+  }
+#else
+  (void)self;
+  (void)number_of_samples;
+#endif
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "worker_job.h"
+#include <string.h>
+
+bool worker_job_schedule(const LV2_Worker_Schedule *schedule,
+                         WorkerJobFunction work, WorkerJobFunction complete,
+                         void *data) {
+  if (!schedule || !work) {
+    return false;
+  }
+
+  const WorkerJob job = {.work = work, .complete = complete, .data = data};
+
+  return schedule->schedule_work(schedule->handle, sizeof(WorkerJob), &job) ==
+         LV2_WORKER_SUCCESS;
+}
+
+LV2_Worker_Status worker_job_work(LV2_Handle instance,
+                                  LV2_Worker_Respond_Function respond,
+                                  LV2_Worker_Respond_Handle handle,
+                                  const uint32_t size, const void *data) {
+  if (size != sizeof(WorkerJob)) {
+    return LV2_WORKER_ERR_UNKNOWN;
+  }
+
+  WorkerJob job;
+  memcpy(&job, data, sizeof(WorkerJob));
+
+  job.work(instance, &job);
+
+  if (!job.complete) {
+    return LV2_WORKER_SUCCESS;
+  }
+
+  return respond(handle, sizeof(WorkerJob), &job);
+}
+
+LV2_Worker_Status worker_job_work_response(LV2_Handle instance,
+                                           const uint32_t size,
+                                           const void *body) {
+  if (size != sizeof(WorkerJob)) {
+    return LV2_WORKER_ERR_UNKNOWN;
+  }
+
+  WorkerJob job;
+  memcpy(&job, body, sizeof(WorkerJob));
+
+  job.complete(instance, &job);
+
+  return LV2_WORKER_SUCCESS;
+}
@@ -0,0 +1,51 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef WORKER_JOB_H
+#define WORKER_JOB_H
+
+#include "lv2/core/lv2.h"
+#include "lv2/worker/worker.h"
+#include <stdbool.h>
+
+// Non realtime work handed to the host's worker thread. A job runs on the
+// worker and is then sent back, so its completion runs in the audio thread
+// between two blocks. Jobs travel by value through the host's ring buffer.
+
+typedef struct WorkerJob WorkerJob;
+typedef void (*WorkerJobFunction)(LV2_Handle instance, WorkerJob *job);
+
+struct WorkerJob {
+  WorkerJobFunction work;     // Worker thread, may allocate and do I/O
+  WorkerJobFunction complete; // Audio thread, NULL if nothing to apply
+  void *data;
+};
+
+bool worker_job_schedule(const LV2_Worker_Schedule *schedule,
+                         WorkerJobFunction work, WorkerJobFunction complete,
+                         void *data);
+LV2_Worker_Status worker_job_work(LV2_Handle instance,
+                                  LV2_Worker_Respond_Function respond,
+                                  LV2_Worker_Respond_Handle handle,
+                                  uint32_t size, const void *data);
+LV2_Worker_Status worker_job_work_response(LV2_Handle instance, uint32_t size,
+                                           const void *body);
+
+#endif
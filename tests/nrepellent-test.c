@@ -0,0 +1,948 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../tools/lv2_host.h"
+#include "../tools/plugin_variants.h"
+#include "../tools/test_signals.h"
+#include "lv2/atom/atom.h"
+#include "lv2/atom/util.h"
+#include "lv2/state/state.h"
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define SAMPLE_RATE 48000.0
+#define BLOCK_SIZE 256U
+#define LEARN_SECONDS 0.5
+#define WARM_UP_SECONDS 0.5
+#define GOLDEN_SECONDS 4.0
+#define STATE_SECONDS 3.0
+#define COMPARE_SECONDS 1.0
+#define BUDGET_SECONDS 2.0
+#define NOTIFY_SECONDS 1.0
+
+// Outputs are compared as levels over windows of 16 blocks, which tolerates
+// the rounding differences between compilers and instruction sets
+#define WINDOW_BLOCKS 16U
+#define MAX_WINDOWS 64U
+#define LEVEL_FLOOR_DB -120.0
+#define GOLDEN_TOLERANCE_DB 0.5
+#define STATE_TOLERANCE_DB 1.0
+// Windows after the restore during which the frames of the two instances
+// still hold different input
+#define STATE_SKIPPED_WINDOWS 4U
+
+#define MAX_STATE_ENTRIES 64U
+#define NOTIFY_CAPACITY 8192U
+#define SPECTRUM_URI "https://github.com/lucianodato/noise-repellent#Spectrum"
+#define MAX_LINE 512U
+
+#define MAX_CHANNELS PLUGIN_VARIANT_MAX_CHANNELS
+#define MAX_PORTS PLUGIN_VARIANT_MAX_PORTS
+#define NO_PORT PLUGIN_VARIANT_NO_PORT
+
+typedef struct TestInstance {
+  const LV2_Descriptor *descriptor;
+  const PluginVariant *variant;
+  LV2_Handle handle;
+  float controls[MAX_PORTS];
+  float input[MAX_CHANNELS][BLOCK_SIZE];
+  float output[MAX_CHANNELS][BLOCK_SIZE];
+  LV2_Atom_Sequence control;
+  uint64_t notify[NOTIFY_CAPACITY / sizeof(uint64_t)]; // Atom aligned
+  LV2_URID atom_Chunk;
+} TestInstance;
+
+// Noisy speech, with a different noise on every channel
+typedef struct TestInput {
+  SpeechSource *speech;
+  uint32_t seeds[MAX_CHANNELS];
+} TestInput;
+
+typedef struct Levels {
+  double energy[MAX_CHANNELS];
+  uint32_t blocks;
+  uint32_t windows;
+  double levels[MAX_WINDOWS][MAX_CHANNELS];
+} Levels;
+
+typedef struct StateEntry {
+  uint32_t key;
+  uint32_t type;
+  size_t size;
+  void *value;
+} StateEntry;
+
+typedef struct StateStore {
+  StateEntry entries[MAX_STATE_ENTRIES];
+  uint32_t number_of_entries;
+} StateStore;
+
+typedef struct TestOptions {
+  const char *only_variant;
+  const char *golden_directory;
+  const char *budget_file;
+  bool update_golden;
+} TestOptions;
+
+static double now_ns(void) {
+  struct timespec time_now;
+  clock_gettime(CLOCK_MONOTONIC, &time_now);
+  return (double)time_now.tv_sec * 1e9 + (double)time_now.tv_nsec;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  const double x = *(const double *)a;
+  const double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static uint32_t seconds_to_blocks(const double seconds) {
+  return (uint32_t)(seconds * SAMPLE_RATE / BLOCK_SIZE) + 1U;
+}
+
+static bool instance_open(TestInstance *self, Lv2Host *host,
+                          const LV2_Descriptor *descriptor,
+                          const PluginVariant *variant) {
+  memset(self, 0, sizeof(TestInstance));
+  self->descriptor = descriptor;
+  self->variant = variant;
+  self->control.atom.size = sizeof(LV2_Atom_Sequence_Body);
+  self->control.atom.type = lv2_host_map(host, LV2_ATOM__Sequence);
+  self->atom_Chunk = lv2_host_map(host, LV2_ATOM__Chunk);
+
+  self->handle = descriptor->instantiate(descriptor, SAMPLE_RATE, "",
+                                         lv2_host_get_features(host));
+  if (!self->handle) {
+    printf("FAIL %s: could not instantiate\n", variant->name);
+    return false;
+  }
+
+  memcpy(self->controls, variant->defaults, sizeof(self->controls));
+  for (uint32_t port = 0U; port < variant->number_of_ports; port++) {
+    descriptor->connect_port(self->handle, port, &self->controls[port]);
+  }
+  for (uint32_t c = 0U; c < variant->channels; c++) {
+    const uint32_t port = variant->first_audio_port + 2U * c;
+    descriptor->connect_port(self->handle, port, self->input[c]);
+    descriptor->connect_port(self->handle, port + 1U, self->output[c]);
+  }
+  if (variant->control_port != NO_PORT) {
+    descriptor->connect_port(self->handle, variant->control_port,
+                             &self->control);
+  }
+  if (variant->notify_port != NO_PORT) {
+    descriptor->connect_port(self->handle, variant->notify_port,
+                             self->notify);
+  }
+
+  if (descriptor->activate) {
+    descriptor->activate(self->handle);
+  }
+
+  return true;
+}
+
+static void instance_close(TestInstance *self) {
+  if (!self->handle) {
+    return;
+  }
+
+  if (self->descriptor->deactivate) {
+    self->descriptor->deactivate(self->handle);
+  }
+  self->descriptor->cleanup(self->handle);
+  self->handle = NULL;
+}
+
+static bool instance_run(TestInstance *self) {
+  // Output sequences are handed over empty, with their capacity as size
+  LV2_Atom *notify = (LV2_Atom *)self->notify;
+  notify->size = NOTIFY_CAPACITY - sizeof(LV2_Atom);
+  notify->type = self->atom_Chunk;
+
+  self->descriptor->run(self->handle, BLOCK_SIZE);
+
+  for (uint32_t c = 0U; c < self->variant->channels; c++) {
+    for (uint32_t k = 0U; k < BLOCK_SIZE; k++) {
+      if (!isfinite(self->output[c][k])) {
+        printf("FAIL %s: non finite output on channel %u\n",
+               self->variant->name, (unsigned int)c);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static void instance_clear_input(TestInstance *self) {
+  memset(self->input, 0, sizeof(self->input));
+}
+
+static bool test_input_initialize(TestInput *self) {
+  self->speech = speech_source_initialize(SAMPLE_RATE);
+  for (uint32_t c = 0U; c < MAX_CHANNELS; c++) {
+    self->seeds[c] = c + 1U;
+  }
+
+  return self->speech != NULL;
+}
+
+static void test_input_free(TestInput *self) {
+  speech_source_free(self->speech);
+}
+
+static void test_input_fill(TestInput *self, TestInstance *instance,
+                            const bool speech) {
+  static float voice[BLOCK_SIZE];
+  if (speech) {
+    speech_source_fill(self->speech, voice, BLOCK_SIZE);
+  }
+
+  for (uint32_t c = 0U; c < instance->variant->channels; c++) {
+    white_noise_fill(instance->input[c], BLOCK_SIZE, &self->seeds[c]);
+    for (uint32_t k = 0U; speech && k < BLOCK_SIZE; k++) {
+      instance->input[c][k] += voice[k];
+    }
+  }
+}
+
+// Manual variants need a profile before they reduce anything
+static bool learn_profile(TestInstance *self, TestInput *input) {
+  const uint32_t learn_port = self->variant->learn_port;
+  if (learn_port == NO_PORT) {
+    return true;
+  }
+
+  self->controls[learn_port] = 1.F;
+  for (uint32_t block = 0U; block < seconds_to_blocks(LEARN_SECONDS);
+       block++) {
+    test_input_fill(input, self, false);
+    if (!instance_run(self)) {
+      return false;
+    }
+  }
+  self->controls[learn_port] = 0.F;
+
+  return true;
+}
+
+static void levels_add(Levels *self, const TestInstance *instance) {
+  if (self->windows >= MAX_WINDOWS) {
+    return;
+  }
+
+  const uint32_t channels = instance->variant->channels;
+  for (uint32_t c = 0U; c < channels; c++) {
+    const float *output = instance->output[c];
+    for (uint32_t k = 0U; k < BLOCK_SIZE; k++) {
+      self->energy[c] += (double)output[k] * output[k];
+    }
+  }
+
+  if (++self->blocks < WINDOW_BLOCKS) {
+    return;
+  }
+
+  for (uint32_t c = 0U; c < channels; c++) {
+    const double mean = self->energy[c] / (double)(WINDOW_BLOCKS * BLOCK_SIZE);
+    const double level = mean > 0.0 ? 10.0 * log10(mean) : LEVEL_FLOOR_DB;
+    self->levels[self->windows][c] = fmax(level, LEVEL_FLOOR_DB);
+    self->energy[c] = 0.0;
+  }
+  self->blocks = 0U;
+  self->windows++;
+}
+
+static LV2_State_Status store_value(LV2_State_Handle handle, uint32_t key,
+                                    const void *value, size_t size,
+                                    uint32_t type, uint32_t flags) {
+  StateStore *self = (StateStore *)handle;
+  if (self->number_of_entries >= MAX_STATE_ENTRIES) {
+    return LV2_STATE_ERR_UNKNOWN;
+  }
+
+  StateEntry *entry = &self->entries[self->number_of_entries];
+  entry->value = malloc(size);
+  if (!entry->value) {
+    return LV2_STATE_ERR_UNKNOWN;
+  }
+
+  memcpy(entry->value, value, size);
+  entry->key = key;
+  entry->type = type;
+  entry->size = size;
+  self->number_of_entries++;
+
+  return LV2_STATE_SUCCESS;
+}
+
+static const void *retrieve_value(LV2_State_Handle handle, uint32_t key,
+                                  size_t *size, uint32_t *type,
+                                  uint32_t *flags) {
+  const StateStore *self = (const StateStore *)handle;
+  for (uint32_t e = 0U; e < self->number_of_entries; e++) {
+    if (self->entries[e].key == key) {
+      *size = self->entries[e].size;
+      *type = self->entries[e].type;
+      *flags = LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE;
+      return self->entries[e].value;
+    }
+  }
+
+  return NULL;
+}
+
+static void state_store_free(StateStore *self) {
+  for (uint32_t e = 0U; e < self->number_of_entries; e++) {
+    free(self->entries[e].value);
+  }
+  self->number_of_entries = 0U;
+}
+
+// An impulse has to come out exactly as many samples late as reported, with
+// nothing to reduce and after a deactivate and activate cycle
+static bool check_latency(Lv2Host *host, const LV2_Descriptor *descriptor,
+                          const PluginVariant *variant) {
+  TestInstance *instance = (TestInstance *)calloc(1U, sizeof(TestInstance));
+  if (!instance || !instance_open(instance, host, descriptor, variant)) {
+    free(instance);
+    return false;
+  }
+
+  bool passed = true;
+  instance->controls[variant->amount_port] = 0.F;
+  for (uint32_t block = 0U;
+       passed && block < seconds_to_blocks(WARM_UP_SECONDS); block++) {
+    passed = instance_run(instance);
+  }
+
+  if (descriptor->deactivate) {
+    descriptor->deactivate(instance->handle);
+  }
+  if (descriptor->activate) {
+    descriptor->activate(instance->handle);
+  }
+
+  uint32_t peak_position[MAX_CHANNELS] = {0U};
+  float peak[MAX_CHANNELS] = {0.F};
+  uint32_t latency = 0U;
+  uint32_t blocks = 1U;
+  for (uint32_t block = 0U; passed && block < blocks; block++) {
+    instance_clear_input(instance);
+    for (uint32_t c = 0U; block == 0U && c < variant->channels; c++) {
+      instance->input[c][0] = 1.F;
+    }
+
+    passed = instance_run(instance);
+    if (block == 0U) {
+      latency = (uint32_t)instance->controls[variant->latency_port];
+      blocks = latency / BLOCK_SIZE + 2U;
+    }
+
+    for (uint32_t c = 0U; c < variant->channels; c++) {
+      for (uint32_t k = 0U; k < BLOCK_SIZE; k++) {
+        if (fabsf(instance->output[c][k]) > peak[c]) {
+          peak[c] = fabsf(instance->output[c][k]);
+          peak_position[c] = block * BLOCK_SIZE + k;
+        }
+      }
+    }
+  }
+
+  for (uint32_t c = 0U; passed && c < variant->channels; c++) {
+    if (peak_position[c] != latency || peak[c] < 0.5F) {
+      printf("FAIL %s latency: reported %u, impulse at %u with %.3f on "
+             "channel %u\n",
+             variant->name, (unsigned int)latency,
+             (unsigned int)peak_position[c], peak[c], (unsigned int)c);
+      passed = false;
+    }
+  }
+  if (passed) {
+    printf("PASS %s latency: %u samples\n", variant->name,
+           (unsigned int)latency);
+  }
+
+  instance_close(instance);
+  free(instance);
+  return passed;
+}
+
+static void golden_path(char *path, const size_t size,
+                        const char *golden_directory,
+                        const PluginVariant *variant) {
+  snprintf(path, size, "%s/%s.golden", golden_directory, variant->name);
+}
+
+static bool write_golden(const char *path, const PluginVariant *variant,
+                         const Levels *levels) {
+  FILE *file = fopen(path, "w");
+  if (!file) {
+    printf("FAIL %s golden: could not write %s\n", variant->name, path);
+    return false;
+  }
+
+  fprintf(file,
+          "# %s at %.0f Hz, level in dB of every channel per %u samples\n",
+          variant->name, SAMPLE_RATE,
+          (unsigned int)(WINDOW_BLOCKS * BLOCK_SIZE));
+  for (uint32_t w = 0U; w < levels->windows; w++) {
+    for (uint32_t c = 0U; c < variant->channels; c++) {
+      fprintf(file, c == 0U ? "%.2f" : " %.2f", levels->levels[w][c]);
+    }
+    fputc('\n', file);
+  }
+
+  const bool written = fclose(file) == 0;
+  printf("%s %s golden: %s\n", written ? "UPDATED" : "FAIL", variant->name,
+         path);
+  return written;
+}
+
+static bool compare_golden(FILE *file, const PluginVariant *variant,
+                           const Levels *levels) {
+  char line[MAX_LINE];
+  uint32_t window = 0U;
+
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#' || line[0] == '\n') {
+      continue;
+    }
+    if (window >= levels->windows) {
+      printf("FAIL %s golden: expected more than %u windows\n", variant->name,
+             (unsigned int)levels->windows);
+      return false;
+    }
+
+    char *cursor = line;
+    for (uint32_t c = 0U; c < variant->channels; c++) {
+      char *end = NULL;
+      const double expected = strtod(cursor, &end);
+      if (end == cursor) {
+        printf("FAIL %s golden: window %u misses channel %u\n", variant->name,
+               (unsigned int)window, (unsigned int)c);
+        return false;
+      }
+      cursor = end;
+
+      const double level = levels->levels[window][c];
+      if (fabs(level - expected) > GOLDEN_TOLERANCE_DB) {
+        printf("FAIL %s golden: window %u channel %u is %.2f dB, expected "
+               "%.2f dB\n",
+               variant->name, (unsigned int)window, (unsigned int)c, level,
+               expected);
+        return false;
+      }
+    }
+    window++;
+  }
+
+  if (window != levels->windows) {
+    printf("FAIL %s golden: expected %u windows, got %u\n", variant->name,
+           (unsigned int)window, (unsigned int)levels->windows);
+    return false;
+  }
+
+  printf("PASS %s golden: %u windows within %.1f dB\n", variant->name,
+         (unsigned int)window, GOLDEN_TOLERANCE_DB);
+  return true;
+}
+
+// Noisy speech through the default settings, compared with the stored levels
+static bool check_golden(Lv2Host *host, const LV2_Descriptor *descriptor,
+                         const PluginVariant *variant,
+                         const TestOptions *options) {
+  TestInstance *instance = (TestInstance *)calloc(1U, sizeof(TestInstance));
+  Levels *levels = (Levels *)calloc(1U, sizeof(Levels));
+  TestInput input;
+  const bool allocated = test_input_initialize(&input) && instance && levels;
+  bool passed = allocated && instance_open(instance, host, descriptor, variant);
+
+  passed = passed && learn_profile(instance, &input);
+  for (uint32_t block = 0U;
+       passed && block < seconds_to_blocks(GOLDEN_SECONDS); block++) {
+    test_input_fill(&input, instance, true);
+    passed = instance_run(instance);
+    levels_add(levels, instance);
+  }
+
+  if (passed) {
+    char path[MAX_LINE];
+    golden_path(path, sizeof(path), options->golden_directory, variant);
+
+    if (options->update_golden) {
+      passed = write_golden(path, variant, levels);
+    } else {
+      FILE *file = fopen(path, "r");
+      if (file) {
+        passed = compare_golden(file, variant, levels);
+        fclose(file);
+      } else if (errno == ENOENT) {
+        printf("FAIL %s golden: no %s, run the update-golden target on a "
+               "reference build\n",
+               variant->name, path);
+        passed = false;
+      } else {
+        printf("FAIL %s golden: could not read %s\n", variant->name, path);
+        passed = false;
+      }
+    }
+  }
+
+  if (instance) {
+    instance_close(instance);
+  }
+  free(instance);
+  free(levels);
+  test_input_free(&input);
+  return passed;
+}
+
+// A fresh instance restored from the saved state has to process like the one
+// that saved it, once both see the same input
+static StateEntry *find_state_entry(Lv2Host *host, StateStore *store,
+                                    const char *suffix) {
+  const size_t suffix_length = strlen(suffix);
+
+  for (uint32_t e = 0U; e < store->number_of_entries; e++) {
+    const char *uri = lv2_host_unmap(host, store->entries[e].key);
+    const size_t length = uri ? strlen(uri) : 0U;
+    if (length >= suffix_length &&
+        strcmp(uri + length - suffix_length, suffix) == 0) {
+      return &store->entries[e];
+    }
+  }
+
+  return NULL;
+}
+
+// A state written by a newer layout has to be refused rather than misread
+static bool rejects_unknown_version(Lv2Host *host,
+                                    const LV2_Descriptor *descriptor,
+                                    const PluginVariant *variant,
+                                    const LV2_State_Interface *state,
+                                    StateStore *store) {
+  StateEntry *entry = find_state_entry(host, store, "#noiseprofileversion");
+  if (!entry || entry->size != sizeof(uint32_t)) {
+    return true;
+  }
+
+  TestInstance *instance = (TestInstance *)calloc(1U, sizeof(TestInstance));
+  if (!instance || !instance_open(instance, host, descriptor, variant)) {
+    free(instance);
+    return false;
+  }
+
+  uint32_t *version = (uint32_t *)entry->value;
+  (*version)++;
+  const bool rejected = state->restore(instance->handle, retrieve_value,
+                                       store, 0U, NULL) != LV2_STATE_SUCCESS;
+  (*version)--;
+
+  if (!rejected) {
+    printf("FAIL %s state: unknown version %u restored\n", variant->name,
+           (unsigned int)(*version + 1U));
+  }
+
+  instance_close(instance);
+  free(instance);
+  return rejected;
+}
+
+// Saving again before any block ran has to hand back the restored state, not
+// whatever the engines held before
+static bool resaves_restored_state(Lv2Host *host,
+                                   const LV2_Descriptor *descriptor,
+                                   const PluginVariant *variant,
+                                   const LV2_State_Interface *state,
+                                   StateStore *store) {
+  TestInstance *instance = (TestInstance *)calloc(1U, sizeof(TestInstance));
+  StateStore *resaved = (StateStore *)calloc(1U, sizeof(StateStore));
+  bool passed =
+      instance && resaved && instance_open(instance, host, descriptor, variant);
+
+  passed = passed &&
+           state->restore(instance->handle, retrieve_value, store, 0U,
+                          NULL) == LV2_STATE_SUCCESS &&
+           state->save(instance->handle, store_value, resaved, 0U, NULL) ==
+               LV2_STATE_SUCCESS;
+
+  for (uint32_t e = 0U; passed && e < store->number_of_entries; e++) {
+    const StateEntry *entry = &store->entries[e];
+    size_t size = 0U;
+    uint32_t type = 0U;
+    uint32_t flags = 0U;
+    const void *value =
+        retrieve_value(resaved, entry->key, &size, &type, &flags);
+
+    if (!value || size != entry->size ||
+        memcmp(value, entry->value, size) != 0) {
+      printf("FAIL %s state: %s is not saved back after a restore\n",
+             variant->name, lv2_host_unmap(host, entry->key));
+      passed = false;
+    }
+  }
+
+  if (instance) {
+    instance_close(instance);
+  }
+  if (resaved) {
+    state_store_free(resaved);
+  }
+  free(instance);
+  free(resaved);
+  return passed;
+}
+
+static bool check_state(Lv2Host *host, const LV2_Descriptor *descriptor,
+                        const PluginVariant *variant) {
+  TestInstance *saved = (TestInstance *)calloc(1U, sizeof(TestInstance));
+  TestInstance *restored = (TestInstance *)calloc(1U, sizeof(TestInstance));
+  Levels *saved_levels = (Levels *)calloc(1U, sizeof(Levels));
+  Levels *restored_levels = (Levels *)calloc(1U, sizeof(Levels));
+  StateStore *store = (StateStore *)calloc(1U, sizeof(StateStore));
+  TestInput input;
+  const bool allocated = test_input_initialize(&input) && saved && restored &&
+                         saved_levels && restored_levels && store;
+  const LV2_State_Interface *state =
+      descriptor->extension_data
+          ? (const LV2_State_Interface *)descriptor->extension_data(
+                LV2_STATE__interface)
+          : NULL;
+  const bool skipped = allocated && !state;
+  if (skipped) {
+    printf("SKIP %s state: nothing is saved\n", variant->name);
+  }
+
+  bool passed = allocated && state &&
+                instance_open(saved, host, descriptor, variant);
+
+  passed = passed && learn_profile(saved, &input);
+  for (uint32_t block = 0U;
+       passed && block < seconds_to_blocks(STATE_SECONDS); block++) {
+    test_input_fill(&input, saved, true);
+    passed = instance_run(saved);
+  }
+
+  if (passed && state->save(saved->handle, store_value, store, 0U, NULL) !=
+                    LV2_STATE_SUCCESS) {
+    printf("FAIL %s state: save failed\n", variant->name);
+    passed = false;
+  }
+
+  passed = passed && instance_open(restored, host, descriptor, variant);
+  if (passed && state->restore(restored->handle, retrieve_value, store, 0U,
+                               NULL) != LV2_STATE_SUCCESS) {
+    printf("FAIL %s state: restore failed\n", variant->name);
+    passed = false;
+  }
+
+  for (uint32_t block = 0U;
+       passed && block < seconds_to_blocks(COMPARE_SECONDS); block++) {
+    test_input_fill(&input, saved, true);
+    memcpy(restored->input, saved->input, sizeof(saved->input));
+    passed = instance_run(saved) && instance_run(restored);
+    levels_add(saved_levels, saved);
+    levels_add(restored_levels, restored);
+  }
+
+  for (uint32_t w = STATE_SKIPPED_WINDOWS;
+       passed && w < saved_levels->windows; w++) {
+    for (uint32_t c = 0U; passed && c < variant->channels; c++) {
+      const double difference =
+          fabs(saved_levels->levels[w][c] - restored_levels->levels[w][c]);
+      if (difference > STATE_TOLERANCE_DB) {
+        printf("FAIL %s state: restored instance differs by %.2f dB in "
+               "window %u on channel %u\n",
+               variant->name, difference, (unsigned int)w, (unsigned int)c);
+        passed = false;
+      }
+    }
+  }
+  passed = passed &&
+           rejects_unknown_version(host, descriptor, variant, state, store);
+  passed = passed &&
+           resaves_restored_state(host, descriptor, variant, state, store);
+
+  if (passed) {
+    printf("PASS %s state: %u entries restored\n", variant->name,
+           (unsigned int)store->number_of_entries);
+  }
+
+  if (saved) {
+    instance_close(saved);
+  }
+  if (restored) {
+    instance_close(restored);
+  }
+  if (store) {
+    state_store_free(store);
+  }
+  free(saved);
+  free(restored);
+  free(saved_levels);
+  free(restored_levels);
+  free(store);
+  test_input_free(&input);
+  return passed || skipped;
+}
+
+// Bands of the first spectrum object in the notify sequence, 0 if none
+static uint32_t notified_bands(Lv2Host *host, const TestInstance *instance) {
+  const LV2_Atom_Sequence *notify =
+      (const LV2_Atom_Sequence *)instance->notify;
+  const LV2_URID atom_Object = lv2_host_map(host, LV2_ATOM__Object);
+  const LV2_URID atom_Vector = lv2_host_map(host, LV2_ATOM__Vector);
+  const LV2_URID spectrum = lv2_host_map(host, SPECTRUM_URI);
+
+  LV2_ATOM_SEQUENCE_FOREACH(notify, event) {
+    const LV2_Atom_Object *object = (const LV2_Atom_Object *)&event->body;
+    if (event->body.type != atom_Object || object->body.otype != spectrum) {
+      continue;
+    }
+
+    LV2_ATOM_OBJECT_FOREACH(object, property) {
+      if (property->value.type == atom_Vector) {
+        const LV2_Atom_Vector *vector =
+            (const LV2_Atom_Vector *)&property->value;
+        return (vector->atom.size - sizeof(LV2_Atom_Vector_Body)) /
+               vector->body.child_size;
+      }
+    }
+  }
+
+  return 0U;
+}
+
+// Variants with a notify port have to publish the learned noise spectrum
+static bool check_notify(Lv2Host *host, const LV2_Descriptor *descriptor,
+                         const PluginVariant *variant) {
+  if (variant->notify_port == NO_PORT) {
+    return true;
+  }
+
+  TestInstance *instance = (TestInstance *)calloc(1U, sizeof(TestInstance));
+  TestInput input;
+  const bool allocated = test_input_initialize(&input) && instance;
+  bool passed = allocated && instance_open(instance, host, descriptor, variant);
+  passed = passed && learn_profile(instance, &input);
+
+  uint32_t bands = 0U;
+  for (uint32_t block = 0U;
+       passed && bands == 0U && block < seconds_to_blocks(NOTIFY_SECONDS);
+       block++) {
+    test_input_fill(&input, instance, true);
+    passed = instance_run(instance);
+    bands = passed ? notified_bands(host, instance) : 0U;
+  }
+
+  if (passed && bands == 0U) {
+    printf("FAIL %s notify: no spectrum object within %.1f s\n",
+           variant->name, NOTIFY_SECONDS);
+    passed = false;
+  }
+  if (passed) {
+    printf("PASS %s notify: spectrum of %u bands\n", variant->name,
+           (unsigned int)bands);
+  }
+
+  if (instance) {
+    instance_close(instance);
+  }
+  free(instance);
+  test_input_free(&input);
+  return passed;
+}
+
+// Largest share of the block duration the 99th percentile may take, or a
+// negative value when the file has no budget for the variant
+static double read_budget(const char *path, const PluginVariant *variant) {
+  FILE *file = path ? fopen(path, "r") : NULL;
+  if (!file) {
+    return -1.0;
+  }
+
+  char line[MAX_LINE];
+  char name[MAX_LINE];
+  double budget = -1.0;
+  while (fgets(line, sizeof(line), file)) {
+    double value = 0.0;
+    if (line[0] != '#' && sscanf(line, "%511s %lf", name, &value) == 2 &&
+        strcmp(name, variant->name) == 0) {
+      budget = value;
+    }
+  }
+
+  fclose(file);
+  return budget;
+}
+
+static bool check_budget(Lv2Host *host, const LV2_Descriptor *descriptor,
+                         const PluginVariant *variant,
+                         const TestOptions *options) {
+  const double budget = read_budget(options->budget_file, variant);
+  if (budget < 0.0) {
+    printf("SKIP %s budget: none stored\n", variant->name);
+    return true;
+  }
+
+  const uint32_t number_of_blocks = seconds_to_blocks(BUDGET_SECONDS);
+  TestInstance *instance = (TestInstance *)calloc(1U, sizeof(TestInstance));
+  double *block_times = (double *)calloc(number_of_blocks, sizeof(double));
+  TestInput input;
+  const bool allocated =
+      test_input_initialize(&input) && instance && block_times;
+  bool passed = allocated && instance_open(instance, host, descriptor, variant);
+
+  passed = passed && learn_profile(instance, &input);
+  for (uint32_t block = 0U; passed && block < number_of_blocks; block++) {
+    test_input_fill(&input, instance, true);
+
+    const double start = now_ns();
+    descriptor->run(instance->handle, BLOCK_SIZE);
+    block_times[block] = now_ns() - start;
+  }
+
+  if (passed) {
+    qsort(block_times, number_of_blocks, sizeof(double), compare_doubles);
+
+    const double block_ns = 1e9 * (double)BLOCK_SIZE / SAMPLE_RATE;
+    const double load =
+        block_times[(uint32_t)(0.99 * (number_of_blocks - 1U))] / block_ns;
+    passed = load <= budget;
+    printf("%s %s budget: 99th percentile block takes %.1f%% of its "
+           "duration, %.1f%% allowed\n",
+           passed ? "PASS" : "FAIL", variant->name, 100.0 * load,
+           100.0 * budget);
+  }
+
+  if (instance) {
+    instance_close(instance);
+  }
+  free(instance);
+  free(block_times);
+  test_input_free(&input);
+  return passed;
+}
+
+static void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] NREPELLENT_LIBRARY NREPELLENT_ADAPTIVE_LIBRARY\n"
+          "Options:\n"
+          "  -p NAME     only test the given plugin variant\n"
+          "  -g DIR      only compare with the golden outputs in DIR\n"
+          "  -t FILE     only check the per block time budgets in FILE\n"
+          "  -u          write the golden outputs instead of comparing\n",
+          program);
+}
+
+int main(int argc, char **argv) {
+  TestOptions options = {NULL, NULL, NULL, false};
+
+  int arg = 1;
+  for (; arg < argc && argv[arg][0] == '-'; arg++) {
+    const char option = argv[arg][1];
+    if (option == 'u') {
+      options.update_golden = true;
+      continue;
+    }
+    if (arg + 1 >= argc) {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+
+    switch (option) {
+    case 'p':
+      options.only_variant = argv[++arg];
+      break;
+    case 'g':
+      options.golden_directory = argv[++arg];
+      break;
+    case 't':
+      options.budget_file = argv[++arg];
+      break;
+    default:
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (argc - arg != 2 || (options.update_golden && !options.golden_directory)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (options.update_golden) {
+    mkdir(options.golden_directory, 0755);
+  }
+
+  const char *libraries[2] = {argv[arg], argv[arg + 1]};
+
+  Lv2Host *host = lv2_host_initialize();
+  if (!host) {
+    return EXIT_FAILURE;
+  }
+
+  int status = EXIT_SUCCESS;
+  for (size_t v = 0U; v < number_of_plugin_variants; v++) {
+    const PluginVariant *variant = &plugin_variants[v];
+    if (options.only_variant && strcmp(options.only_variant, variant->name)) {
+      continue;
+    }
+
+    const LV2_Descriptor *descriptor = lv2_host_load_descriptor(
+        host, libraries[variant->library], variant->uri);
+    if (!descriptor) {
+      printf("FAIL %s: could not load <%s> from %s\n", variant->name,
+             variant->uri, libraries[variant->library]);
+      status = EXIT_FAILURE;
+      continue;
+    }
+
+    // Golden outputs and time budgets are checked on their own, so the
+    // timing only runs when asked for
+    bool passed = true;
+    if (options.golden_directory) {
+      passed = check_golden(host, descriptor, variant, &options);
+    } else if (options.budget_file) {
+      passed = check_budget(host, descriptor, variant, &options);
+    } else {
+      passed = check_latency(host, descriptor, variant) && passed;
+      passed = check_state(host, descriptor, variant) && passed;
+      passed = check_notify(host, descriptor, variant) && passed;
+    }
+
+    if (!passed) {
+      status = EXIT_FAILURE;
+    }
+    fflush(stdout);
+  }
+
+  lv2_host_free(host);
+
+  return status;
+}
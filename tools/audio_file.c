@@ -0,0 +1,385 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "audio_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHUNK_FRAMES 4096U
+#define WAVE_FORMAT_PCM 0x0001U
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003U
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFEU
+#define WAV_HEADER_SIZE 44L
+
+typedef enum SampleFormat {
+  SAMPLE_FORMAT_INT16,
+  SAMPLE_FORMAT_INT24,
+  SAMPLE_FORMAT_INT32,
+  SAMPLE_FORMAT_FLOAT32,
+} SampleFormat;
+
+struct AudioFileReader {
+  FILE *file;
+  uint32_t sample_rate;
+  uint32_t channels;
+  uint32_t bytes_per_sample;
+  SampleFormat format;
+  uint64_t frames;
+  uint64_t frames_left;
+  uint8_t *buffer;
+};
+
+struct AudioFileWriter {
+  FILE *file;
+  uint32_t channels;
+  uint64_t frames;
+  float *buffer;
+};
+
+static uint16_t read_le16(const uint8_t *bytes) {
+  return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static uint32_t read_le32(const uint8_t *bytes) {
+  return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+         ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void write_le16(uint8_t *bytes, const uint16_t value) {
+  bytes[0] = (uint8_t)(value & 0xFFU);
+  bytes[1] = (uint8_t)(value >> 8);
+}
+
+static void write_le32(uint8_t *bytes, const uint32_t value) {
+  bytes[0] = (uint8_t)(value & 0xFFU);
+  bytes[1] = (uint8_t)((value >> 8) & 0xFFU);
+  bytes[2] = (uint8_t)((value >> 16) & 0xFFU);
+  bytes[3] = (uint8_t)(value >> 24);
+}
+
+static float decode_sample(const uint8_t *bytes, const SampleFormat format) {
+  switch (format) {
+  case SAMPLE_FORMAT_INT16:
+    return (float)(int16_t)read_le16(bytes) / 32768.F;
+  case SAMPLE_FORMAT_INT24: {
+    const int32_t value = (int32_t)(((uint32_t)bytes[0] << 8) |
+                                    ((uint32_t)bytes[1] << 16) |
+                                    ((uint32_t)bytes[2] << 24)) >>
+                          8;
+    return (float)value / 8388608.F;
+  }
+  case SAMPLE_FORMAT_INT32:
+    return (float)((double)(int32_t)read_le32(bytes) / 2147483648.0);
+  case SAMPLE_FORMAT_FLOAT32: {
+    const uint32_t bits = read_le32(bytes);
+    float value = 0.F;
+    memcpy(&value, &bits, sizeof(float));
+    return value;
+  }
+  default:
+    return 0.F;
+  }
+}
+
+static AudioFileReader *reader_allocate(FILE *file, const uint32_t sample_rate,
+                                        const uint32_t channels,
+                                        const SampleFormat format,
+                                        const uint32_t bytes_per_sample,
+                                        const uint64_t data_size) {
+  if (sample_rate == 0U || channels == 0U) {
+    return NULL;
+  }
+
+  AudioFileReader *self =
+      (AudioFileReader *)calloc(1U, sizeof(AudioFileReader));
+  if (!self) {
+    return NULL;
+  }
+
+  self->file = file;
+  self->sample_rate = sample_rate;
+  self->channels = channels;
+  self->format = format;
+  self->bytes_per_sample = bytes_per_sample;
+  self->frames = data_size / ((uint64_t)bytes_per_sample * channels);
+  self->frames_left = self->frames;
+  self->buffer = (uint8_t *)malloc((size_t)CHUNK_FRAMES * channels *
+                                   bytes_per_sample);
+  if (!self->buffer) {
+    free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+AudioFileReader *audio_file_reader_open_wav(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  uint8_t header[12];
+  if (fread(header, 1U, sizeof(header), file) != sizeof(header) ||
+      memcmp(header, "RIFF", 4U) != 0 || memcmp(header + 8, "WAVE", 4U) != 0) {
+    fclose(file);
+    return NULL;
+  }
+
+  uint16_t format_tag = 0U;
+  uint32_t channels = 0U;
+  uint32_t sample_rate = 0U;
+  uint32_t bits_per_sample = 0U;
+
+  uint8_t chunk_header[8];
+  while (fread(chunk_header, 1U, sizeof(chunk_header), file) ==
+         sizeof(chunk_header)) {
+    const uint32_t chunk_size = read_le32(chunk_header + 4);
+
+    if (memcmp(chunk_header, "fmt ", 4U) == 0) {
+      uint8_t fmt[40] = {0};
+      const uint32_t to_read =
+          chunk_size < sizeof(fmt) ? chunk_size : (uint32_t)sizeof(fmt);
+      if (chunk_size < 16U || fread(fmt, 1U, to_read, file) != to_read) {
+        break;
+      }
+      format_tag = read_le16(fmt);
+      channels = read_le16(fmt + 2);
+      sample_rate = read_le32(fmt + 4);
+      bits_per_sample = read_le16(fmt + 14);
+      if (format_tag == WAVE_FORMAT_EXTENSIBLE && to_read >= 26U) {
+        format_tag = read_le16(fmt + 24); // First bytes of the SubFormat GUID
+      }
+      fseek(file, (long)(chunk_size - to_read + (chunk_size & 1U)), SEEK_CUR);
+    } else if (memcmp(chunk_header, "data", 4U) == 0) {
+      SampleFormat format;
+      if (format_tag == WAVE_FORMAT_IEEE_FLOAT && bits_per_sample == 32U) {
+        format = SAMPLE_FORMAT_FLOAT32;
+      } else if (format_tag == WAVE_FORMAT_PCM && bits_per_sample == 16U) {
+        format = SAMPLE_FORMAT_INT16;
+      } else if (format_tag == WAVE_FORMAT_PCM && bits_per_sample == 24U) {
+        format = SAMPLE_FORMAT_INT24;
+      } else if (format_tag == WAVE_FORMAT_PCM && bits_per_sample == 32U) {
+        format = SAMPLE_FORMAT_INT32;
+      } else {
+        break; // Unsupported encoding
+      }
+
+      AudioFileReader *self =
+          reader_allocate(file, sample_rate, channels, format,
+                          bits_per_sample / 8U, (uint64_t)chunk_size);
+      if (!self) {
+        break;
+      }
+      return self;
+    } else {
+      fseek(file, (long)(chunk_size + (chunk_size & 1U)), SEEK_CUR);
+    }
+  }
+
+  fclose(file);
+  return NULL;
+}
+
+AudioFileReader *audio_file_reader_open_raw(const char *path,
+                                            const uint32_t sample_rate,
+                                            const uint32_t channels) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return NULL;
+  }
+
+  fseek(file, 0L, SEEK_END);
+  const long file_size = ftell(file);
+  fseek(file, 0L, SEEK_SET);
+
+  AudioFileReader *self =
+      reader_allocate(file, sample_rate, channels, SAMPLE_FORMAT_FLOAT32,
+                      (uint32_t)sizeof(float),
+                      file_size > 0L ? (uint64_t)file_size : 0U);
+  if (!self) {
+    fclose(file);
+  }
+
+  return self;
+}
+
+void audio_file_reader_close(AudioFileReader *self) {
+  if (self->file) {
+    fclose(self->file);
+  }
+  free(self->buffer);
+  free(self);
+}
+
+uint32_t audio_file_reader_get_sample_rate(const AudioFileReader *self) {
+  return self->sample_rate;
+}
+
+uint32_t audio_file_reader_get_channels(const AudioFileReader *self) {
+  return self->channels;
+}
+
+uint64_t audio_file_reader_get_frames(const AudioFileReader *self) {
+  return self->frames;
+}
+
+uint32_t audio_file_reader_read(AudioFileReader *self, float **channels,
+                                const uint32_t number_of_frames) {
+  uint32_t frames_read = 0U;
+  const uint32_t frame_bytes = self->bytes_per_sample * self->channels;
+
+  while (frames_read < number_of_frames && self->frames_left > 0U) {
+    uint32_t to_read = number_of_frames - frames_read;
+    if (to_read > CHUNK_FRAMES) {
+      to_read = CHUNK_FRAMES;
+    }
+    if ((uint64_t)to_read > self->frames_left) {
+      to_read = (uint32_t)self->frames_left;
+    }
+
+    const size_t got = fread(self->buffer, frame_bytes, to_read, self->file);
+    for (uint32_t k = 0U; k < (uint32_t)got; k++) {
+      for (uint32_t c = 0U; c < self->channels; c++) {
+        channels[c][frames_read + k] = decode_sample(
+            self->buffer + (size_t)k * frame_bytes +
+                (size_t)c * self->bytes_per_sample,
+            self->format);
+      }
+    }
+
+    frames_read += (uint32_t)got;
+    self->frames_left -= got;
+    if (got < to_read) {
+      self->frames_left = 0U; // Truncated file
+    }
+  }
+
+  return frames_read;
+}
+
+static bool write_wav_header(FILE *file, const uint32_t sample_rate,
+                             const uint32_t channels, const uint64_t frames) {
+  const uint32_t block_align = channels * (uint32_t)sizeof(float);
+  const uint64_t data_size = frames * block_align;
+  const uint32_t clamped_size =
+      data_size > 0xFFFFFFFFULL - 36U ? 0xFFFFFFFFU - 36U : (uint32_t)data_size;
+
+  uint8_t header[WAV_HEADER_SIZE];
+  memcpy(header, "RIFF", 4U);
+  write_le32(header + 4, clamped_size + 36U);
+  memcpy(header + 8, "WAVEfmt ", 8U);
+  write_le32(header + 16, 16U);
+  write_le16(header + 20, (uint16_t)WAVE_FORMAT_IEEE_FLOAT);
+  write_le16(header + 22, (uint16_t)channels);
+  write_le32(header + 24, sample_rate);
+  write_le32(header + 28, sample_rate * block_align);
+  write_le16(header + 32, (uint16_t)block_align);
+  write_le16(header + 34, 32U);
+  memcpy(header + 36, "data", 4U);
+  write_le32(header + 40, clamped_size);
+
+  return fwrite(header, 1U, sizeof(header), file) == sizeof(header);
+}
+
+AudioFileWriter *audio_file_writer_open_wav(const char *path,
+                                            const uint32_t sample_rate,
+                                            const uint32_t channels) {
+  if (channels == 0U) {
+    return NULL;
+  }
+
+  AudioFileWriter *self =
+      (AudioFileWriter *)calloc(1U, sizeof(AudioFileWriter));
+  if (!self) {
+    return NULL;
+  }
+
+  self->channels = channels;
+  self->buffer = (float *)malloc(sizeof(float) * CHUNK_FRAMES * channels);
+  self->file = fopen(path, "wb");
+
+  if (!self->buffer || !self->file ||
+      !write_wav_header(self->file, sample_rate, channels, 0U)) {
+    if (self->file) {
+      fclose(self->file);
+    }
+    free(self->buffer);
+    free(self);
+    return NULL;
+  }
+
+  return self;
+}
+
+bool audio_file_writer_write(AudioFileWriter *self,
+                             const float *const *channels,
+                             const uint32_t number_of_frames) {
+  uint32_t written = 0U;
+
+  while (written < number_of_frames) {
+    uint32_t to_write = number_of_frames - written;
+    if (to_write > CHUNK_FRAMES) {
+      to_write = CHUNK_FRAMES;
+    }
+
+    for (uint32_t k = 0U; k < to_write; k++) {
+      for (uint32_t c = 0U; c < self->channels; c++) {
+        float sample = channels[c][written + k];
+        uint32_t bits = 0U;
+        memcpy(&bits, &sample, sizeof(float));
+        write_le32((uint8_t *)&self->buffer[k * self->channels + c], bits);
+      }
+    }
+
+    if (fwrite(self->buffer, sizeof(float) * self->channels, to_write,
+               self->file) != to_write) {
+      return false;
+    }
+
+    written += to_write;
+  }
+
+  self->frames += number_of_frames;
+  return true;
+}
+
+bool audio_file_writer_close(AudioFileWriter *self) {
+  bool success = true;
+  const uint32_t block_align = self->channels * (uint32_t)sizeof(float);
+  const uint64_t data_size = self->frames * block_align;
+  const uint32_t clamped_size =
+      data_size > 0xFFFFFFFFULL - 36U ? 0xFFFFFFFFU - 36U : (uint32_t)data_size;
+
+  uint8_t size_field[4];
+  write_le32(size_field, clamped_size + 36U);
+  success &= fseek(self->file, 4L, SEEK_SET) == 0 &&
+             fwrite(size_field, 1U, 4U, self->file) == 4U;
+  write_le32(size_field, clamped_size);
+  success &= fseek(self->file, 40L, SEEK_SET) == 0 &&
+             fwrite(size_field, 1U, 4U, self->file) == 4U;
+  success &= fclose(self->file) == 0;
+
+  free(self->buffer);
+  free(self);
+
+  return success;
+}
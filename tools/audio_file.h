@@ -0,0 +1,52 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef AUDIO_FILE_H
+#define AUDIO_FILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Streaming readers and writers for WAV and headerless PCM files. Samples are
+// always exchanged as deinterleaved float channels.
+
+typedef struct AudioFileReader AudioFileReader;
+typedef struct AudioFileWriter AudioFileWriter;
+
+AudioFileReader *audio_file_reader_open_wav(const char *path);
+AudioFileReader *audio_file_reader_open_raw(const char *path,
+                                            uint32_t sample_rate,
+                                            uint32_t channels);
+void audio_file_reader_close(AudioFileReader *self);
+uint32_t audio_file_reader_get_sample_rate(const AudioFileReader *self);
+uint32_t audio_file_reader_get_channels(const AudioFileReader *self);
+uint64_t audio_file_reader_get_frames(const AudioFileReader *self);
+uint32_t audio_file_reader_read(AudioFileReader *self, float **channels,
+                                uint32_t number_of_frames);
+
+AudioFileWriter *audio_file_writer_open_wav(const char *path,
+                                            uint32_t sample_rate,
+                                            uint32_t channels);
+bool audio_file_writer_write(AudioFileWriter *self,
+                             const float *const *channels,
+                             uint32_t number_of_frames);
+bool audio_file_writer_close(AudioFileWriter *self);
+
+#endif
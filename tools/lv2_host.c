@@ -0,0 +1,179 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "lv2_host.h"
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LIBRARIES 8U
+#define MAX_FEATURES 8U
+
+struct Lv2Host {
+  char **uris;
+  uint32_t number_of_uris;
+  uint32_t uris_capacity;
+  pthread_mutex_t uris_lock;
+
+  LV2_URID_Map map;
+  LV2_URID_Unmap unmap;
+  LV2_Feature map_feature;
+  LV2_Feature unmap_feature;
+  const LV2_Feature *features[MAX_FEATURES];
+
+  void *libraries[MAX_LIBRARIES];
+  uint32_t number_of_libraries;
+};
+
+static LV2_URID map_uri(LV2_URID_Map_Handle handle, const char *uri) {
+  Lv2Host *self = (Lv2Host *)handle;
+  LV2_URID urid = 0U;
+
+  pthread_mutex_lock(&self->uris_lock);
+
+  for (uint32_t k = 0U; k < self->number_of_uris; k++) {
+    if (strcmp(self->uris[k], uri) == 0) {
+      urid = k + 1U;
+      break;
+    }
+  }
+
+  if (urid == 0U) {
+    if (self->number_of_uris == self->uris_capacity) {
+      const uint32_t capacity =
+          self->uris_capacity > 0U ? self->uris_capacity * 2U : 64U;
+      char **uris = (char **)realloc(self->uris, capacity * sizeof(char *));
+      if (uris) {
+        self->uris = uris;
+        self->uris_capacity = capacity;
+      }
+    }
+
+    if (self->number_of_uris < self->uris_capacity) {
+      self->uris[self->number_of_uris] = strdup(uri);
+      urid = ++self->number_of_uris;
+    }
+  }
+
+  pthread_mutex_unlock(&self->uris_lock);
+
+  return urid;
+}
+
+static const char *unmap_uri(LV2_URID_Unmap_Handle handle,
+                             const LV2_URID urid) {
+  Lv2Host *self = (Lv2Host *)handle;
+  const char *uri = NULL;
+
+  pthread_mutex_lock(&self->uris_lock);
+  if (urid > 0U && urid <= self->number_of_uris) {
+    uri = self->uris[urid - 1U];
+  }
+  pthread_mutex_unlock(&self->uris_lock);
+
+  return uri;
+}
+
+Lv2Host *lv2_host_initialize(void) {
+  Lv2Host *self = (Lv2Host *)calloc(1U, sizeof(Lv2Host));
+  if (!self) {
+    return NULL;
+  }
+
+  pthread_mutex_init(&self->uris_lock, NULL);
+
+  self->map = (LV2_URID_Map){.handle = self, .map = map_uri};
+  self->unmap = (LV2_URID_Unmap){.handle = self, .unmap = unmap_uri};
+  self->map_feature = (LV2_Feature){.URI = LV2_URID__map, .data = &self->map};
+  self->unmap_feature =
+      (LV2_Feature){.URI = LV2_URID__unmap, .data = &self->unmap};
+
+  self->features[0] = &self->map_feature;
+  self->features[1] = &self->unmap_feature;
+  self->features[2] = NULL;
+
+  return self;
+}
+
+void lv2_host_free(Lv2Host *self) {
+  for (uint32_t k = 0U; k < self->number_of_libraries; k++) {
+    dlclose(self->libraries[k]);
+  }
+
+  for (uint32_t k = 0U; k < self->number_of_uris; k++) {
+    free(self->uris[k]);
+  }
+  free(self->uris);
+
+  pthread_mutex_destroy(&self->uris_lock);
+  free(self);
+}
+
+LV2_URID lv2_host_map(Lv2Host *self, const char *uri) {
+  return map_uri(self, uri);
+}
+
+const char *lv2_host_unmap(Lv2Host *self, const LV2_URID urid) {
+  return unmap_uri(self, urid);
+}
+
+const LV2_Feature *const *lv2_host_get_features(Lv2Host *self) {
+  return self->features;
+}
+
+const LV2_Descriptor *lv2_host_load_descriptor(Lv2Host *self,
+                                               const char *library_path,
+                                               const char *uri) {
+  if (self->number_of_libraries == MAX_LIBRARIES) {
+    return NULL;
+  }
+
+  void *library = dlopen(library_path, RTLD_NOW | RTLD_LOCAL);
+  if (!library) {
+    return NULL;
+  }
+
+  LV2_Descriptor_Function descriptor_function = NULL;
+  *(void **)&descriptor_function = dlsym(library, "lv2_descriptor");
+
+  const LV2_Descriptor *descriptor = NULL;
+  for (uint32_t index = 0U; descriptor_function; index++) {
+    const LV2_Descriptor *candidate = descriptor_function(index);
+    if (!candidate) {
+      break;
+    }
+    if (strcmp(candidate->URI, uri) == 0) {
+      descriptor = candidate;
+      break;
+    }
+  }
+
+  if (!descriptor) {
+    dlclose(library);
+    return NULL;
+  }
+
+  self->libraries[self->number_of_libraries++] = library;
+
+  return descriptor;
+}
@@ -0,0 +1,44 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef LV2_HOST_H
+#define LV2_HOST_H
+
+#include "lv2/core/lv2.h"
+#include "lv2/urid/urid.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Minimal headless host used by the benchmarks and the tests. It loads plugin
+// binaries directly, without parsing the bundle data, and offers the features
+// the plugins of this repository need.
+
+typedef struct Lv2Host Lv2Host;
+
+Lv2Host *lv2_host_initialize(void);
+void lv2_host_free(Lv2Host *self);
+LV2_URID lv2_host_map(Lv2Host *self, const char *uri);
+const char *lv2_host_unmap(Lv2Host *self, LV2_URID urid);
+const LV2_Feature *const *lv2_host_get_features(Lv2Host *self);
+const LV2_Descriptor *lv2_host_load_descriptor(Lv2Host *self,
+                                               const char *library_path,
+                                               const char *uri);
+
+#endif
@@ -0,0 +1,719 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "../src/denormal_guard.h"
+#include "../src/profile_library.h"
+#include "audio_file.h"
+#include "specbleach_denoiser.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define DEFAULT_BLOCK_SIZE 512U
+#define MAX_CHANNELS 64U
+#define PROFILE_FILE_MAGIC "NRPF"
+#define PROFILE_FILE_VERSION 1U
+
+typedef struct NoiseProfile {
+  uint32_t sample_rate;
+  uint32_t size;
+  uint32_t averaged_blocks;
+  float *elements;
+} NoiseProfile;
+
+typedef struct RenderOptions {
+  SpectralBleachParameters parameters;
+  const char *profile_path;
+  const char *learn_path;
+  const char *save_profile_path;
+  const char *library_path;
+  const char *profile_name;
+  const char *output_directory;
+  uint32_t block_size;
+  uint32_t jobs;
+  uint32_t raw_sample_rate;
+  uint32_t raw_channels;
+} RenderOptions;
+
+typedef struct RenderQueue {
+  const RenderOptions *options;
+  const NoiseProfile *profile;
+  const ProfileLibrary *library;
+  char **files;
+  int number_of_files;
+  int next_file;
+  int failures;
+  pthread_mutex_t lock;
+} RenderQueue;
+
+static double now_seconds(void) {
+  struct timespec time_now;
+  clock_gettime(CLOCK_MONOTONIC, &time_now);
+  return (double)time_now.tv_sec + (double)time_now.tv_nsec * 1e-9;
+}
+
+static uint32_t number_of_cores(void) {
+#ifdef _WIN32
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors
+                                       : 1U;
+#else
+  const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 0L ? (uint32_t)cores : 1U;
+#endif
+}
+
+static AudioFileReader *open_input(const RenderOptions *options,
+                                   const char *path) {
+  if (options->raw_sample_rate > 0U) {
+    return audio_file_reader_open_raw(path, options->raw_sample_rate,
+                                      options->raw_channels);
+  }
+  return audio_file_reader_open_wav(path);
+}
+
+static bool write_u32(FILE *file, const uint32_t value) {
+  const uint8_t bytes[4] = {(uint8_t)(value & 0xFFU),
+                            (uint8_t)((value >> 8) & 0xFFU),
+                            (uint8_t)((value >> 16) & 0xFFU),
+                            (uint8_t)(value >> 24)};
+  return fwrite(bytes, 1U, 4U, file) == 4U;
+}
+
+static bool read_u32(FILE *file, uint32_t *value) {
+  uint8_t bytes[4];
+  if (fread(bytes, 1U, 4U, file) != 4U) {
+    return false;
+  }
+  *value = (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) |
+           ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+  return true;
+}
+
+static bool noise_profile_save(const NoiseProfile *profile, const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (!file) {
+    return false;
+  }
+
+  bool success = fwrite(PROFILE_FILE_MAGIC, 1U, 4U, file) == 4U &&
+                 write_u32(file, PROFILE_FILE_VERSION) &&
+                 write_u32(file, profile->sample_rate) &&
+                 write_u32(file, profile->size) &&
+                 write_u32(file, profile->averaged_blocks);
+
+  for (uint32_t k = 0U; success && k < profile->size; k++) {
+    uint32_t bits = 0U;
+    memcpy(&bits, &profile->elements[k], sizeof(float));
+    success = write_u32(file, bits);
+  }
+
+  return fclose(file) == 0 && success;
+}
+
+static bool noise_profile_load(NoiseProfile *profile, const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+
+  char magic[4];
+  uint32_t version = 0U;
+  bool success = fread(magic, 1U, 4U, file) == 4U &&
+                 memcmp(magic, PROFILE_FILE_MAGIC, 4U) == 0 &&
+                 read_u32(file, &version) && version == PROFILE_FILE_VERSION &&
+                 read_u32(file, &profile->sample_rate) &&
+                 read_u32(file, &profile->size) &&
+                 read_u32(file, &profile->averaged_blocks) &&
+                 profile->size > 0U;
+
+  if (success) {
+    profile->elements = (float *)calloc(profile->size, sizeof(float));
+    success = profile->elements != NULL;
+  }
+
+  for (uint32_t k = 0U; success && k < profile->size; k++) {
+    uint32_t bits = 0U;
+    success = read_u32(file, &bits);
+    memcpy(&profile->elements[k], &bits, sizeof(float));
+  }
+
+  fclose(file);
+  return success;
+}
+
+// Learns a single profile from every channel of a noise-only recording.
+// Each channel has its own estimator so frames never mix two channels, and
+// the profiles are averaged by the number of blocks behind each of them
+static bool learn_noise_profile(const RenderOptions *options,
+                                NoiseProfile *profile) {
+  AudioFileReader *reader = open_input(options, options->learn_path);
+  if (!reader) {
+    return false;
+  }
+  const uint32_t sample_rate = audio_file_reader_get_sample_rate(reader);
+  const uint32_t channels = audio_file_reader_get_channels(reader);
+
+  if (channels > MAX_CHANNELS) {
+    audio_file_reader_close(reader);
+    return false;
+  }
+
+  SpectralBleachHandle lib_instances[MAX_CHANNELS] = {NULL};
+  float *block_in[MAX_CHANNELS] = {NULL};
+  float *block_out = (float *)calloc(options->block_size, sizeof(float));
+  bool success = block_out != NULL;
+
+  SpectralBleachParameters parameters = options->parameters;
+  parameters.learn_noise = true;
+  for (uint32_t c = 0U; success && c < channels; c++) {
+    lib_instances[c] = specbleach_initialize(sample_rate);
+    block_in[c] = (float *)calloc(options->block_size, sizeof(float));
+    success = lib_instances[c] != NULL && block_in[c] != NULL;
+    if (success) {
+      specbleach_load_parameters(lib_instances[c], parameters);
+    }
+  }
+
+  uint32_t frames = 0U;
+  while (success && (frames = audio_file_reader_read(
+                         reader, block_in, options->block_size)) > 0U) {
+    for (uint32_t c = 0U; c < channels; c++) {
+      specbleach_process(lib_instances[c], frames, block_in[c], block_out);
+    }
+  }
+  audio_file_reader_close(reader);
+
+  uint32_t total_blocks = 0U;
+  for (uint32_t c = 0U; success && c < channels; c++) {
+    if (!specbleach_noise_profile_available(lib_instances[c])) {
+      continue;
+    }
+
+    const uint32_t blocks =
+        specbleach_get_noise_profile_blocks_averaged(lib_instances[c]);
+    const float *elements = specbleach_get_noise_profile(lib_instances[c]);
+    if (!profile->elements) {
+      profile->size = specbleach_get_noise_profile_size(lib_instances[c]);
+      profile->elements = (float *)calloc(profile->size, sizeof(float));
+      success = profile->elements != NULL;
+    }
+    for (uint32_t k = 0U; success && k < profile->size; k++) {
+      profile->elements[k] += (float)blocks * elements[k];
+    }
+    total_blocks += blocks;
+  }
+
+  if (success && total_blocks > 0U) {
+    for (uint32_t k = 0U; k < profile->size; k++) {
+      profile->elements[k] /= (float)total_blocks;
+    }
+    profile->sample_rate = sample_rate;
+    profile->averaged_blocks = total_blocks;
+  } else {
+    success = false;
+    free(profile->elements);
+    profile->elements = NULL;
+  }
+
+  for (uint32_t c = 0U; c < channels; c++) {
+    if (lib_instances[c]) {
+      specbleach_free(lib_instances[c]);
+    }
+    free(block_in[c]);
+  }
+  free(block_out);
+
+  return success;
+}
+
+static char *output_path_for(const char *output_directory,
+                             const char *input_path) {
+  const char *name = strrchr(input_path, '/');
+#ifdef _WIN32
+  const char *windows_name = strrchr(input_path, '\\');
+  if (windows_name && (!name || windows_name > name)) {
+    name = windows_name;
+  }
+#endif
+  name = name ? name + 1 : input_path;
+
+  const char *extension = strrchr(name, '.');
+  const size_t stem_length =
+      extension && extension != name ? (size_t)(extension - name)
+                                     : strlen(name);
+  const size_t length = strlen(output_directory) + 1U + stem_length + 5U;
+
+  char *path = (char *)calloc(length, sizeof(char));
+  if (path) {
+    snprintf(path, length, "%s/%.*s.wav", output_directory, (int)stem_length,
+             name);
+  }
+
+  return path;
+}
+
+typedef struct OutputName {
+  char *path;
+  const char *input_path;
+} OutputName;
+
+static int compare_output_names(const void *a, const void *b) {
+  return strcmp(((const OutputName *)a)->path, ((const OutputName *)b)->path);
+}
+
+// Inputs with the same name in different directories would be written to
+// the same output by two workers at once, so they are refused up front
+static bool check_output_names(const char *output_directory, char **files,
+                               const int number_of_files) {
+  OutputName *names =
+      (OutputName *)calloc((size_t)number_of_files + 1U, sizeof(OutputName));
+  if (!names) {
+    return false;
+  }
+
+  bool success = true;
+  for (int k = 0; success && k < number_of_files; k++) {
+    names[k].path = output_path_for(output_directory, files[k]);
+    names[k].input_path = files[k];
+    success = names[k].path != NULL;
+  }
+
+  if (success) {
+    qsort(names, (size_t)number_of_files, sizeof(OutputName),
+          compare_output_names);
+  }
+  for (int k = 1; success && k < number_of_files; k++) {
+    if (strcmp(names[k - 1].path, names[k].path) == 0) {
+      fprintf(stderr, "%s and %s would both be written to %s\n",
+              names[k - 1].input_path, names[k].input_path, names[k].path);
+      success = false;
+    }
+  }
+
+  for (int k = 0; k < number_of_files; k++) {
+    free(names[k].path);
+  }
+  free(names);
+
+  return success;
+}
+
+static bool library_path_for(const RenderOptions *options, char *path,
+                             const size_t size) {
+  if (options->library_path) {
+    return snprintf(path, size, "%s", options->library_path) < (int)size;
+  }
+  return profile_library_default_path(path, size);
+}
+
+// Library profiles are looked up per file so each one gets its own rate
+static bool load_library_profile(const RenderOptions *options,
+                                 const ProfileLibrary *library,
+                                 SpectralBleachHandle lib_instance,
+                                 const uint32_t sample_rate) {
+  const uint32_t fft_size =
+      (specbleach_get_noise_profile_size(lib_instance) - 1U) * 2U;
+  uint32_t profile_size = 0U;
+  uint32_t averaged_blocks = 0U;
+
+  const float *profile =
+      profile_library_find(library, options->profile_name, sample_rate,
+                           fft_size, &profile_size, &averaged_blocks);
+  return profile && specbleach_load_noise_profile(lib_instance, profile,
+                                                  profile_size,
+                                                  averaged_blocks);
+}
+
+static bool render_file(const RenderOptions *options,
+                        const NoiseProfile *profile,
+                        const ProfileLibrary *library,
+                        const char *input_path) {
+  AudioFileReader *reader = open_input(options, input_path);
+  if (!reader) {
+    fprintf(stderr, "%s: could not open input\n", input_path);
+    return false;
+  }
+
+  const uint32_t sample_rate = audio_file_reader_get_sample_rate(reader);
+  const uint32_t channels = audio_file_reader_get_channels(reader);
+  const uint32_t block_size = options->block_size;
+
+  if (channels > MAX_CHANNELS) {
+    fprintf(stderr, "%s: too many channels\n", input_path);
+    audio_file_reader_close(reader);
+    return false;
+  }
+
+  if (profile->elements && profile->sample_rate != sample_rate) {
+    fprintf(stderr, "%s: noise profile was learned at %u Hz, file is %u Hz\n",
+            input_path, (unsigned int)profile->sample_rate,
+            (unsigned int)sample_rate);
+    audio_file_reader_close(reader);
+    return false;
+  }
+
+  SpectralBleachHandle lib_instances[MAX_CHANNELS] = {NULL};
+  float *block_in[MAX_CHANNELS] = {NULL};
+  float *block_out[MAX_CHANNELS] = {NULL};
+  bool success = true;
+
+  for (uint32_t c = 0U; success && c < channels; c++) {
+    lib_instances[c] = specbleach_initialize(sample_rate);
+    block_in[c] = (float *)calloc(block_size, sizeof(float));
+    block_out[c] = (float *)calloc(block_size, sizeof(float));
+    success = lib_instances[c] && block_in[c] && block_out[c];
+
+    if (success && profile->elements) {
+      success = specbleach_load_noise_profile(lib_instances[c],
+                                              profile->elements, profile->size,
+                                              profile->averaged_blocks);
+    } else if (success && library) {
+      success = load_library_profile(options, library, lib_instances[c],
+                                     sample_rate);
+      if (!success) {
+        fprintf(stderr, "%s: no profile named %s at %u Hz in the library\n",
+                input_path, options->profile_name, (unsigned int)sample_rate);
+      }
+    }
+    if (success) {
+      specbleach_load_parameters(lib_instances[c], options->parameters);
+    }
+  }
+
+  char *output_path = output_path_for(options->output_directory, input_path);
+  AudioFileWriter *writer =
+      success && output_path
+          ? audio_file_writer_open_wav(output_path, sample_rate, channels)
+          : NULL;
+  if (!writer) {
+    fprintf(stderr, "%s: could not open output\n", input_path);
+    success = false;
+  }
+
+  const double start = now_seconds();
+
+  if (success) {
+    // Output is shifted back by the engine latency, flushing it with silence
+    const uint32_t latency = specbleach_get_latency(lib_instances[0]);
+    uint32_t to_skip = latency;
+    uint32_t to_flush = latency;
+    float *output_view[MAX_CHANNELS];
+
+    while (success) {
+      uint32_t frames = audio_file_reader_read(reader, block_in, block_size);
+      if (frames == 0U) {
+        if (to_flush == 0U) {
+          break;
+        }
+        frames = to_flush < block_size ? to_flush : block_size;
+        for (uint32_t c = 0U; c < channels; c++) {
+          memset(block_in[c], 0, sizeof(float) * frames);
+        }
+        to_flush -= frames;
+      }
+
+      for (uint32_t c = 0U; c < channels; c++) {
+        specbleach_process(lib_instances[c], frames, block_in[c],
+                           block_out[c]);
+      }
+
+      const uint32_t skipped = to_skip < frames ? to_skip : frames;
+      to_skip -= skipped;
+      for (uint32_t c = 0U; c < channels; c++) {
+        output_view[c] = block_out[c] + skipped;
+      }
+      success = audio_file_writer_write(writer,
+                                        (const float *const *)output_view,
+                                        frames - skipped);
+    }
+  }
+
+  const double elapsed = now_seconds() - start;
+
+  if (writer && !audio_file_writer_close(writer)) {
+    success = false;
+  }
+
+  if (success) {
+    const double duration =
+        (double)audio_file_reader_get_frames(reader) / (double)sample_rate;
+    printf("%s: %.2f s of audio in %.3f s (%.1fx realtime)\n", input_path,
+           duration, elapsed, elapsed > 0.0 ? duration / elapsed : 0.0);
+  } else {
+    fprintf(stderr, "%s: rendering failed\n", input_path);
+  }
+
+  for (uint32_t c = 0U; c < channels; c++) {
+    if (lib_instances[c]) {
+      specbleach_free(lib_instances[c]);
+    }
+    free(block_in[c]);
+    free(block_out[c]);
+  }
+  free(output_path);
+  audio_file_reader_close(reader);
+
+  return success;
+}
+
+static void *render_worker(void *data) {
+  RenderQueue *queue = (RenderQueue *)data;
+
+  DenormalGuard denormal_guard;
+  denormal_guard_enter(&denormal_guard);
+
+  for (;;) {
+    pthread_mutex_lock(&queue->lock);
+    const int file_index = queue->next_file++;
+    pthread_mutex_unlock(&queue->lock);
+
+    if (file_index >= queue->number_of_files) {
+      break;
+    }
+
+    if (!render_file(queue->options, queue->profile, queue->library,
+                     queue->files[file_index])) {
+      pthread_mutex_lock(&queue->lock);
+      queue->failures++;
+      pthread_mutex_unlock(&queue->lock);
+    }
+  }
+
+  denormal_guard_leave(&denormal_guard);
+
+  return NULL;
+}
+
+static void print_usage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] -o OUTPUT_DIR FILE...\n"
+          "Options:\n"
+          "  -o DIR    directory for the rendered WAV files\n"
+          "  -p FILE   noise profile to apply\n"
+          "  -l FILE   learn the noise profile from a noise-only recording\n"
+          "  -s FILE   save the learned noise profile\n"
+          "  -n NAME   profile name in the library, stores a learned profile\n"
+          "            or applies a stored one\n"
+          "  -L FILE   profile library (default: $%s or the user data dir)\n"
+          "  -j N      number of parallel jobs (default: one per core)\n"
+          "  -b N      processing block size (default: %u)\n"
+          "  -R RATE   read inputs as raw 32 bit float PCM at RATE\n"
+          "  -C N      number of interleaved channels for raw input\n"
+          "  -a DB     reduction amount (default: 10)\n"
+          "  -f DB     thresholds offset (default: 0)\n"
+          "  -m PC     smoothing (default: 0)\n"
+          "  -w PC     residual whitening (default: 0)\n"
+          "  -t        protect transients\n",
+          program, "NOISEREPELLENT_PROFILE_LIBRARY", DEFAULT_BLOCK_SIZE);
+}
+
+int main(int argc, char **argv) {
+  // clang-format off
+  RenderOptions options = {
+      .parameters = (SpectralBleachParameters){
+          .reduction_amount = 10.F,
+      },
+      .block_size = DEFAULT_BLOCK_SIZE,
+      .jobs = number_of_cores(),
+      .raw_channels = 1U,
+  };
+  // clang-format on
+
+  int first_file = argc;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const bool has_value = i + 1 < argc;
+
+    if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+      first_file = i;
+      break;
+    }
+
+    if (arg[1] == 't') {
+      options.parameters.transient_protection = true;
+      continue;
+    }
+
+    if (!has_value) {
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+
+    const char *value = argv[++i];
+    switch (arg[1]) {
+    case 'o':
+      options.output_directory = value;
+      break;
+    case 'p':
+      options.profile_path = value;
+      break;
+    case 'l':
+      options.learn_path = value;
+      break;
+    case 's':
+      options.save_profile_path = value;
+      break;
+    case 'n':
+      options.profile_name = value;
+      break;
+    case 'L':
+      options.library_path = value;
+      break;
+    case 'j':
+      options.jobs = (uint32_t)strtoul(value, NULL, 10);
+      break;
+    case 'b':
+      options.block_size = (uint32_t)strtoul(value, NULL, 10);
+      break;
+    case 'R':
+      options.raw_sample_rate = (uint32_t)strtoul(value, NULL, 10);
+      break;
+    case 'C':
+      options.raw_channels = (uint32_t)strtoul(value, NULL, 10);
+      break;
+    case 'a':
+      options.parameters.reduction_amount = strtof(value, NULL);
+      break;
+    case 'f':
+      options.parameters.noise_rescale = strtof(value, NULL);
+      break;
+    case 'm':
+      options.parameters.smoothing_factor = strtof(value, NULL);
+      break;
+    case 'w':
+      options.parameters.whitening_factor = strtof(value, NULL);
+      break;
+    default:
+      print_usage(argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  const int number_of_files = argc - first_file;
+  if (options.block_size == 0U || options.jobs == 0U ||
+      (number_of_files > 0 && !options.output_directory) ||
+      (number_of_files == 0 && !options.learn_path)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (number_of_files > 0 &&
+      !check_output_names(options.output_directory, argv + first_file,
+                          number_of_files)) {
+    return EXIT_FAILURE;
+  }
+
+  char library_path[4096];
+  if (options.profile_name &&
+      !library_path_for(&options, library_path, sizeof(library_path))) {
+    fprintf(stderr, "%s: no profile library path\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  NoiseProfile profile = {0};
+  ProfileLibrary *library = NULL;
+  if (options.learn_path) {
+    if (!learn_noise_profile(&options, &profile)) {
+      fprintf(stderr, "%s: could not learn a noise profile\n",
+              options.learn_path);
+      return EXIT_FAILURE;
+    }
+    if (options.save_profile_path &&
+        !noise_profile_save(&profile, options.save_profile_path)) {
+      fprintf(stderr, "%s: could not save the noise profile\n",
+              options.save_profile_path);
+      free(profile.elements);
+      return EXIT_FAILURE;
+    }
+    if (options.profile_name &&
+        !profile_library_store(library_path, options.profile_name,
+                               profile.sample_rate, (profile.size - 1U) * 2U,
+                               profile.elements, profile.size,
+                               profile.averaged_blocks)) {
+      fprintf(stderr, "%s: could not store the noise profile\n",
+              library_path);
+      free(profile.elements);
+      return EXIT_FAILURE;
+    }
+  } else if (options.profile_path) {
+    if (!noise_profile_load(&profile, options.profile_path)) {
+      fprintf(stderr, "%s: invalid noise profile\n", options.profile_path);
+      free(profile.elements);
+      return EXIT_FAILURE;
+    }
+  } else if (options.profile_name) {
+    library = profile_library_open(library_path);
+    if (!library) {
+      fprintf(stderr, "%s: invalid profile library\n", library_path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  RenderQueue queue = {
+      .options = &options,
+      .profile = &profile,
+      .library = library,
+      .files = argv + first_file,
+      .number_of_files = number_of_files,
+  };
+  pthread_mutex_init(&queue.lock, NULL);
+
+  uint32_t workers = options.jobs;
+  if (workers > (uint32_t)number_of_files) {
+    workers = (uint32_t)number_of_files;
+  }
+
+  pthread_t *threads = (pthread_t *)calloc(workers + 1U, sizeof(pthread_t));
+  uint32_t started = 0U;
+  for (; threads && started < workers; started++) {
+    if (pthread_create(&threads[started], NULL, render_worker, &queue) != 0) {
+      break;
+    }
+  }
+
+  if (started == 0U && number_of_files > 0) {
+    render_worker(&queue); // Fall back to rendering on the calling thread
+  }
+
+  for (uint32_t k = 0U; k < started; k++) {
+    pthread_join(threads[k], NULL);
+  }
+
+  pthread_mutex_destroy(&queue.lock);
+  free(threads);
+  free(profile.elements);
+  if (library) {
+    profile_library_close(library);
+  }
+
+  return queue.failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,60 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "plugin_variants.h"
+
+#ifndef NOISEREPELLENT_MULTICHANNEL_CHANNELS
+#define NOISEREPELLENT_MULTICHANNEL_CHANNELS 8U
+#endif
+#define MULTICHANNEL NOISEREPELLENT_MULTICHANNEL_CHANNELS
+
+_Static_assert(MULTICHANNEL <= PLUGIN_VARIANT_MAX_CHANNELS,
+               "multichannel variant exceeds the host buffers");
+
+// clang-format off
+const PluginVariant plugin_variants[] = {
+    {"manual", "https://github.com/lucianodato/noise-repellent#new",
+     LIBRARY_MANUAL, 1U, 15U, 10U, 5U, 12U, 0U, 8U, 9U, 15U,
+     {10.F, 0.F, 0.F, 0.F, 0.F, 0.F, 0.F, 0.F, 1.F}},
+    {"manual-stereo", "https://github.com/lucianodato/noise-repellent-stereo#new",
+     LIBRARY_MANUAL, 2U, 17U, 10U, 5U, 14U, 0U, 8U, 9U, 17U,
+     {10.F, 0.F, 0.F, 0.F, 0.F, 0.F, 0.F, 0.F, 1.F}},
+    {"manual-multichannel", "https://github.com/lucianodato/noise-repellent-multichannel#new",
+     LIBRARY_MANUAL, MULTICHANNEL, 13U + 2U * MULTICHANNEL, 10U, 5U,
+     10U + 2U * MULTICHANNEL, 0U, 8U, 9U, 13U + 2U * MULTICHANNEL,
+     {10.F, 0.F, 0.F, 0.F, 0.F, 0.F, 0.F, 0.F, 1.F}},
+    {"adaptive", "https://github.com/lucianodato/noise-repellent#adaptive",
+     LIBRARY_ADAPTIVE, 1U, 11U, 6U, PLUGIN_VARIANT_NO_PORT, 8U, 0U, 4U, 5U,
+     PLUGIN_VARIANT_NO_PORT,
+     {10.F, 2.F, 0.F, 0.F, 1.F}},
+    {"adaptive-stereo", "https://github.com/lucianodato/noise-repellent#adaptive-stereo",
+     LIBRARY_ADAPTIVE, 2U, 13U, 6U, PLUGIN_VARIANT_NO_PORT, 10U, 0U, 4U, 5U,
+     PLUGIN_VARIANT_NO_PORT,
+     {10.F, 2.F, 0.F, 0.F, 1.F}},
+    {"adaptive-multichannel", "https://github.com/lucianodato/noise-repellent#adaptive-multichannel",
+     LIBRARY_ADAPTIVE, MULTICHANNEL, 9U + 2U * MULTICHANNEL, 6U,
+     PLUGIN_VARIANT_NO_PORT, 6U + 2U * MULTICHANNEL, 0U, 4U, 5U,
+     PLUGIN_VARIANT_NO_PORT,
+     {10.F, 2.F, 0.F, 0.F, 1.F}},
+};
+// clang-format on
+
+const size_t number_of_plugin_variants =
+    sizeof(plugin_variants) / sizeof(plugin_variants[0]);
@@ -0,0 +1,58 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef PLUGIN_VARIANTS_H
+#define PLUGIN_VARIANTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Port layout of every plugin variant, shared by the benchmarks and the tests
+// so they can drive the binaries without parsing the bundle data.
+
+#define PLUGIN_VARIANT_MAX_PORTS 48U
+#define PLUGIN_VARIANT_MAX_CHANNELS 16U
+#define PLUGIN_VARIANT_NO_PORT UINT32_MAX
+
+typedef enum PluginLibrary {
+  LIBRARY_MANUAL = 0,
+  LIBRARY_ADAPTIVE = 1,
+} PluginLibrary;
+
+typedef struct PluginVariant {
+  const char *name;
+  const char *uri;
+  PluginLibrary library;
+  uint32_t channels;
+  uint32_t number_of_ports; // Ports before the notify one, all controls
+  uint32_t first_audio_port; // Input and output ports alternate per channel
+  uint32_t learn_port;
+  uint32_t control_port;
+  uint32_t amount_port;
+  uint32_t enable_port;
+  uint32_t latency_port;
+  uint32_t notify_port; // Atom output carrying the noise spectrum, if any
+  float defaults[PLUGIN_VARIANT_MAX_PORTS];
+} PluginVariant;
+
+extern const PluginVariant plugin_variants[];
+extern const size_t number_of_plugin_variants;
+
+#endif
@@ -0,0 +1,140 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#include "test_signals.h"
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define NOISE_LEVEL 0.1F
+
+// Synthetic speech: voiced syllables with phrases separated by pauses
+#define SYLLABLE_SECONDS 0.25
+#define PHRASE_SECONDS 2.0
+#define PAUSE_SECONDS 0.5
+#define PITCH_HZ 120.0
+#define PITCH_DEPTH_HZ 30.0
+#define PITCH_RATE_HZ 0.7
+#define FORMANTS 2U
+#define VOWELS 5U
+#define SPEECH_GAIN 1.F
+
+// Decaying silence: the noise fades with a 10 ms time constant, through the
+// denormal range before the first second is over and into digital silence
+#define DECAY_SECONDS 0.01
+
+// Formant frequencies and bandwidths of a, i, u, e and o
+static const double vowel_formants[VOWELS][FORMANTS][2] = {
+    {{730.0, 90.0}, {1090.0, 110.0}}, {{270.0, 60.0}, {2290.0, 100.0}},
+    {{300.0, 60.0}, {870.0, 90.0}},   {{530.0, 70.0}, {1840.0, 100.0}},
+    {{570.0, 80.0}, {840.0, 90.0}},
+};
+
+struct SpeechSource {
+  double sample_rate;
+  uint64_t position;
+  double glottal_phase;
+  float pulse;
+  float coefficients[VOWELS][FORMANTS][3];
+  float history[FORMANTS][2];
+};
+
+// Deterministic white noise so every run measures the same signal
+void white_noise_fill(float *buffer, const uint32_t length, uint32_t *seed) {
+  for (uint32_t k = 0U; k < length; k++) {
+    *seed = *seed * 1664525U + 1013904223U;
+    buffer[k] = ((float)(*seed >> 8) / 8388608.F - 1.F) * NOISE_LEVEL;
+  }
+}
+
+void decay_apply(float *buffer, const uint32_t length, const double sample_rate,
+                 const uint64_t position) {
+  for (uint32_t k = 0U; k < length; k++) {
+    const double time = (double)(position + k) / sample_rate;
+    buffer[k] *= (float)exp(-time / DECAY_SECONDS);
+  }
+}
+
+// Pulse train through two formant resonators, cheap but speech like enough
+// for the estimators to see voiced frames, transitions and pauses
+SpeechSource *speech_source_initialize(const double sample_rate) {
+  SpeechSource *self = (SpeechSource *)calloc(1U, sizeof(SpeechSource));
+  if (!self) {
+    return NULL;
+  }
+
+  self->sample_rate = sample_rate;
+  // Same level whatever the rate, each pulse spreads over the whole band
+  self->pulse = SPEECH_GAIN * (float)sqrt(sample_rate);
+
+  for (uint32_t v = 0U; v < VOWELS; v++) {
+    for (uint32_t f = 0U; f < FORMANTS; f++) {
+      const double radius = exp(-M_PI * vowel_formants[v][f][1] / sample_rate);
+      const double angle = 2.0 * M_PI * vowel_formants[v][f][0] / sample_rate;
+      // Unity gain at the formant frequency
+      self->coefficients[v][f][0] =
+          (float)(2.0 * (1.0 - radius) * sin(angle));
+      self->coefficients[v][f][1] = (float)(2.0 * radius * cos(angle));
+      self->coefficients[v][f][2] = (float)(-radius * radius);
+    }
+  }
+
+  return self;
+}
+
+void speech_source_free(SpeechSource *self) { free(self); }
+
+void speech_source_fill(SpeechSource *self, float *buffer,
+                        const uint32_t length) {
+  for (uint32_t k = 0U; k < length; k++) {
+    const double time = (double)self->position / self->sample_rate;
+    const double syllable = time / SYLLABLE_SECONDS;
+    const double progress = syllable - floor(syllable);
+    const uint32_t vowel = (uint32_t)syllable % VOWELS;
+    const bool pause =
+        fmod(time, PHRASE_SECONDS) >= PHRASE_SECONDS - PAUSE_SECONDS;
+    const double pitch =
+        PITCH_HZ + PITCH_DEPTH_HZ * sin(2.0 * M_PI * PITCH_RATE_HZ * time);
+
+    self->glottal_phase += pitch / self->sample_rate;
+    float sample = 0.F;
+    if (self->glottal_phase >= 1.0) {
+      self->glottal_phase -= 1.0;
+      sample = self->pulse;
+    }
+
+    for (uint32_t f = 0U; f < FORMANTS; f++) {
+      const float *coefficients = self->coefficients[vowel][f];
+      float *history = self->history[f];
+      sample = coefficients[0] * sample + coefficients[1] * history[0] +
+               coefficients[2] * history[1];
+      history[1] = history[0];
+      history[0] = sample;
+    }
+
+    const double envelope = pause ? 0.0 : pow(sin(M_PI * progress), 2.0);
+    buffer[k] = (float)envelope * sample;
+    self->position++;
+  }
+}
@@ -0,0 +1,39 @@
+/*
+noise-repellent -- Noise Reduction LV2
+
+Copyright 2022 Luciano Dato <lucianodato@gmail.com>
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 3 of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public License
+along with this program; if not, write to the Free Software Foundation,
+Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+*/
+
+#ifndef TEST_SIGNALS_H
+#define TEST_SIGNALS_H
+
+#include <stdint.h>
+
+// Deterministic inputs for the benchmarks and the tests, generated in code so
+// no audio files need to be shipped.
+
+typedef struct SpeechSource SpeechSource;
+
+void white_noise_fill(float *buffer, uint32_t length, uint32_t *seed);
+void decay_apply(float *buffer, uint32_t length, double sample_rate,
+                 uint64_t position);
+
+SpeechSource *speech_source_initialize(double sample_rate);
+void speech_source_free(SpeechSource *self);
+void speech_source_fill(SpeechSource *self, float *buffer, uint32_t length);
+
+#endif